@@ -0,0 +1,33 @@
+// Helpers shared by the benchmarks. Each benchmark is a single file linked
+// against the converter's objects (which provide now_seconds); include this
+// before any other header.
+
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#define _POSIX_C_SOURCE 200809L
+#include "../include/pixel_art.h"
+
+// Deterministic RGB test image: smooth gradients with some noise, so
+// palettes and block means see a photo-like spread of colors
+static inline Image* create_test_image(int width, int height) {
+    Image* img = malloc(sizeof(Image));
+    img->width = width;
+    img->height = height;
+    img->channels = 3;
+    img->data = malloc((size_t)width * height * 3);
+
+    uint32_t state = 12345;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t* px = img->data + ((size_t)y * width + x) * 3;
+            state = state * 1664525u + 1013904223u;
+            px[0] = (uint8_t)(x * 255 / width + (state >> 28));
+            px[1] = (uint8_t)(y * 255 / height + ((state >> 24) & 15));
+            px[2] = (uint8_t)((x + y) * 127 / (width + height) + ((state >> 20) & 63));
+        }
+    }
+    return img;
+}
+
+#endif
@@ -0,0 +1,103 @@
+// PNG encode benchmark: compares encode time and output size of the
+// built-in encoder across compression levels and filter strategies, with
+// stb_image_write's encoder as the baseline, then shows how the default
+// configuration scales with the number of threads.
+//
+// Usage: bench_png [image ...]   (default: examples/test1.jpg examples/test2.png)
+
+#include "bench_common.h"
+#include <sys/stat.h>
+
+// Provided by the stb_image_write implementation compiled into image_io.c
+unsigned char* stbi_write_png_to_mem(const unsigned char* pixels, int stride_bytes, int x, int y, int n, int* out_len);
+
+#define BENCH_OUTPUT "bench_png_output.png"
+#define BENCH_PIXEL_SIZE 8
+
+typedef struct {
+    const char* name;
+    int level;
+    PngFilter filter;
+} EncodeConfig;
+
+static const EncodeConfig configs[] = {
+    {"level 1, none (fast)", 1, PNG_FILTER_NONE},
+    {"level 1, auto", 1, PNG_FILTER_AUTO},
+    {"level 6, none", 6, PNG_FILTER_NONE},
+    {"level 6, auto (default)", 6, PNG_FILTER_AUTO},
+    {"level 9, auto", 9, PNG_FILTER_AUTO},
+};
+
+static long file_size(const char* filename) {
+    struct stat st;
+    return stat(filename, &st) == 0 ? (long)st.st_size : -1;
+}
+
+static void report(const char* name, double seconds, long bytes, long raw_bytes) {
+    printf("  %-26s %8.1f ms  %9ld bytes  (%5.1f%% of raw)\n",
+           name, seconds * 1e3, bytes, 100.0 * bytes / raw_bytes);
+}
+
+static void bench_image(const char* label, const Image* img) {
+    long raw_bytes = (long)img->width * img->height * img->channels;
+    printf("%s: %dx%d, %d channels\n", label, img->width, img->height, img->channels);
+
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        set_png_options(configs[i].level, configs[i].filter);
+        double start = now_seconds();
+        if (!write_png(BENCH_OUTPUT, img, 0)) return;
+        report(configs[i].name, now_seconds() - start, file_size(BENCH_OUTPUT), raw_bytes);
+    }
+
+    double start = now_seconds();
+    int length = 0;
+    unsigned char* png = stbi_write_png_to_mem(img->data, img->width * img->channels,
+                                               img->width, img->height, img->channels, &length);
+    report("stb_image_write (level 8)", now_seconds() - start, length, raw_bytes);
+    free(png);
+
+    int max_threads = get_thread_count();
+    set_png_options(PNG_DEFAULT_LEVEL, PNG_FILTER_AUTO);
+    for (int threads = 1;; threads *= 2) {
+        if (threads > max_threads) threads = max_threads;
+        char name[64];
+        snprintf(name, sizeof(name), "default, %d thread%s", threads, threads == 1 ? "" : "s");
+        set_thread_count(threads);
+        start = now_seconds();
+        if (!write_png(BENCH_OUTPUT, img, 0)) break;
+        report(name, now_seconds() - start, file_size(BENCH_OUTPUT), raw_bytes);
+        if (threads == max_threads) break;
+    }
+    set_thread_count(max_threads);
+}
+
+int main(int argc, char* argv[]) {
+    static const char* default_inputs[] = {"examples/test1.jpg", "examples/test2.png"};
+    const char** inputs = argc > 1 ? (const char**)argv + 1 : default_inputs;
+    int input_count = argc > 1 ? argc - 1 : 2;
+
+    for (int i = 0; i < input_count; i++) {
+        Image* source = load_image(inputs[i]);
+        if (!source) continue;
+
+        ConvertOptions options;
+        init_convert_options(&options);
+        options.pixel_size = BENCH_PIXEL_SIZE;
+        Image* pixel_art = convert_image(source, &options);
+
+        char label[512];
+        snprintf(label, sizeof(label), "%s (source)", inputs[i]);
+        bench_image(label, source);
+        if (pixel_art) {
+            snprintf(label, sizeof(label), "%s (pixel art, -s %d)", inputs[i], BENCH_PIXEL_SIZE);
+            bench_image(label, pixel_art);
+        }
+
+        free_image(pixel_art);
+        free_image(source);
+    }
+
+    remove(BENCH_OUTPUT);
+    set_png_options(PNG_DEFAULT_LEVEL, PNG_FILTER_AUTO);
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Quantize stage benchmark: compares the sqrt/double palette search the
+// converter used to run per pixel against the integer squared-distance
+// search, the vectorized lane search and the table-driven quantize_colors.
+// The last line runs the converter's own palette stage: the test image is
+// treated as a grid of cells, and convert_low_res_indexed builds the median
+// cut palette and maps every cell to an index in parallel over rows.
+//
+// Usage: bench_quantize [width height colors]
+
+#include "bench_common.h"
+
+// Reference search matching the original double precision implementation
+static Color closest_color_double(uint8_t r, uint8_t g, uint8_t b, const Palette* palette) {
+    double min_distance = color_distance(r, g, b, palette->colors[0].r, palette->colors[0].g, palette->colors[0].b);
+    int closest = 0;
+    for (int i = 1; i < palette->count; i++) {
+        double distance = color_distance(r, g, b, palette->colors[i].r, palette->colors[i].g, palette->colors[i].b);
+        if (distance < min_distance) {
+            min_distance = distance;
+            closest = i;
+        }
+    }
+    return palette->colors[closest];
+}
+
+static void report(const char* name, double seconds, long pixels, uint32_t checksum) {
+    printf("%-28s %8.1f ms  %8.1f Mpx/s  (checksum %08x)\n",
+           name, seconds * 1e3, pixels / seconds / 1e6, checksum);
+}
+
+int main(int argc, char* argv[]) {
+    int width = argc > 1 ? atoi(argv[1]) : 2048;
+    int height = argc > 2 ? atoi(argv[2]) : 2048;
+    int colors = argc > 3 ? atoi(argv[3]) : 256;
+    long pixels = (long)width * height;
+
+    Image* img = create_test_image(width, height);
+    Palette* palette = create_median_cut_palette(img, colors);
+    if (!palette) return 1;
+
+    printf("Quantize benchmark: %dx%d pixels, %d palette colors, %s search kernel\n",
+           width, height, palette->count, palette_search_kernel_name());
+
+    double start = now_seconds();
+    uint32_t checksum = 0;
+    for (long i = 0; i < pixels; i++) {
+        const uint8_t* px = img->data + i * 3;
+        Color c = closest_color_double(px[0], px[1], px[2], palette);
+        checksum = checksum * 31 + c.r + c.g + c.b;
+    }
+    report("search (double + sqrt)", now_seconds() - start, pixels, checksum);
+
+    start = now_seconds();
+    checksum = 0;
+    for (long i = 0; i < pixels; i++) {
+        const uint8_t* px = img->data + i * 3;
+        Color c = find_closest_color(px[0], px[1], px[2], palette);
+        checksum = checksum * 31 + c.r + c.g + c.b;
+    }
+    report("search (int squared)", now_seconds() - start, pixels, checksum);
+
+    PaletteLanes* lanes = create_palette_lanes(palette);
+    start = now_seconds();
+    checksum = 0;
+    for (long i = 0; i < pixels; i++) {
+        const uint8_t* px = img->data + i * 3;
+        Color c = palette->colors[palette_lanes_nearest(lanes, px[0], px[1], px[2])];
+        checksum = checksum * 31 + c.r + c.g + c.b;
+    }
+    report("search (lanes)", now_seconds() - start, pixels, checksum);
+    free_palette_lanes(lanes);
+
+    start = now_seconds();
+    build_palette_lut(palette);
+    Image* quantized = quantize_colors(img, palette);
+    report("quantize_colors (table)", now_seconds() - start, pixels, 0);
+
+    // One cell per pixel, compact output, as the converter's -c path runs it
+    ConvertOptions options;
+    init_convert_options(&options);
+    options.mode = CONVERT_ADAPTIVE;
+    options.max_colors = colors;
+    options.pixel_size = 1;
+    options.compact = 1;
+    start = now_seconds();
+    IndexedImage* indexed = convert_low_res_indexed(img, width, height, &options);
+    report("converter palette + map", now_seconds() - start, pixels, 0);
+
+    free_indexed_image(indexed);
+    free_image(quantized);
+    free_palette(palette);
+    free_image(img);
+    return 0;
+}
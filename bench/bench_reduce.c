@@ -0,0 +1,59 @@
+// Cell grid benchmark: compares the stb_image_resize2 linear filter the
+// palette path used to run against the integer box reduction, and the
+// summed-area table that serves every block size after one build.
+//
+// Usage: bench_reduce [width height]
+
+#include "bench_common.h"
+
+#define BENCH_RUNS 3
+
+static const int factors[] = {2, 4, 8, 16, 32, 7};
+
+// Best of BENCH_RUNS, so one-off page faults do not count
+static double time_reduce(const Image* img, int width, int height, int box) {
+    double best = 0;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        double start = now_seconds();
+        Image* cells = box ? box_reduce_image(img, width, height) : resize_image(img, width, height);
+        double elapsed = now_seconds() - start;
+        free_image(cells);
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    int width = argc > 1 ? atoi(argv[1]) : 4096;
+    int height = argc > 2 ? atoi(argv[2]) : 4096;
+    Image* img = create_test_image(width, height);
+
+    printf("Reduce benchmark: %dx%d pixels, %s accumulate kernel, %d threads\n",
+           width, height, box_reduce_kernel_name(), get_thread_count());
+
+    double start = now_seconds();
+    SummedAreaTable* table = create_summed_area_table(img);
+    double table_seconds = now_seconds() - start;
+    if (!table) return 1;
+    printf("summed-area table build %8.1f ms\n", table_seconds * 1e3);
+
+    printf("%-8s %12s %12s %12s %8s\n", "factor", "stbir", "box", "table cells", "speedup");
+    for (size_t i = 0; i < sizeof(factors) / sizeof(factors[0]); i++) {
+        int cell_width = width / factors[i];
+        int cell_height = height / factors[i];
+        double stbir = time_reduce(img, cell_width, cell_height, 0);
+        double box = time_reduce(img, cell_width, cell_height, 1);
+
+        start = now_seconds();
+        Image* cells = create_low_res_from_table(table, factors[i]);
+        double from_table = now_seconds() - start;
+        free_image(cells);
+
+        printf("%-8d %9.1f ms %9.1f ms %9.1f ms %7.1fx\n",
+               factors[i], stbir * 1e3, box * 1e3, from_table * 1e3, stbir / box);
+    }
+
+    free_summed_area_table(table);
+    free_image(img);
+    return 0;
+}
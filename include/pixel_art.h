@@ -18,26 +18,268 @@ typedef struct {
     uint8_t r, g, b;
 } Color;
 
+#define LUT_BITS 5
+#define LUT_SIZE (1 << LUT_BITS)
+#define LUT_SHIFT (8 - LUT_BITS)
+
+// Nearest-color lookup for palettes of up to 256 colors. The RGB cube is
+// split into LUT_SIZE^3 cells, and each cell lists, in ascending index
+// order, every palette entry that is nearest to at least one color in the
+// cell. Entries are packed as r << 24 | g << 16 | b << 8 | index so the
+// search reads no other memory.
+typedef struct {
+    uint32_t* offsets;     // LUT_SIZE^3 + 1 starts into candidates
+    uint32_t* candidates;
+} PaletteLut;
+
 typedef struct {
     Color* colors;
     int count;
     int capacity;
+    PaletteLut* lut;  // NULL until built
 } Palette;
 
+// Index into a palette lookup table for the given color
+static inline int lut_index(uint8_t r, uint8_t g, uint8_t b) {
+    return ((r >> LUT_SHIFT) << (2 * LUT_BITS)) | ((g >> LUT_SHIFT) << LUT_BITS) | (b >> LUT_SHIFT);
+}
+
+// Index of the palette color nearest to (r, g, b), the same entry the
+// exhaustive search returns. The palette's table must have been built.
+static inline int palette_lut_nearest(const Palette* palette, uint8_t r, uint8_t g, uint8_t b) {
+    const PaletteLut* lut = palette->lut;
+    int cell = lut_index(r, g, b);
+    const uint32_t* entry = lut->candidates + lut->offsets[cell];
+    const uint32_t* end = lut->candidates + lut->offsets[cell + 1];
+
+    // Distance above the index bits: the smallest key is the nearest entry,
+    // and among equal distances the lowest index
+    uint32_t best = UINT32_MAX;
+    for (; entry < end; entry++) {
+        int dr = r - (int)(*entry >> 24);
+        int dg = g - (int)((*entry >> 16) & 0xff);
+        int db = b - (int)((*entry >> 8) & 0xff);
+        uint32_t key = (uint32_t)(dr * dr + dg * dg + db * db) << 8 | (*entry & 0xff);
+        best = key < best ? key : best;
+    }
+    return (int)(best & 0xff);
+}
+
+// PNG scanline filters; AUTO picks per row for truecolor and uses NONE for
+// indexed images
+typedef enum {
+    PNG_FILTER_AUTO = -1,
+    PNG_FILTER_NONE = 0,
+    PNG_FILTER_SUB = 1,
+    PNG_FILTER_UP = 2,
+    PNG_FILTER_AVERAGE = 3,
+    PNG_FILTER_PAETH = 4
+} PngFilter;
+
+#define PNG_DEFAULT_LEVEL 6
+
+// Image stored as one palette index per pixel. The palette is owned by the
+// image; alpha is an optional per-pixel plane, NULL when fully opaque.
+typedef struct {
+    uint8_t* indices;
+    uint8_t* alpha;
+    int width;
+    int height;
+    Palette* palette;
+} IndexedImage;
+
+// Palette split into separate r/g/b lanes for the vectorized search. Each
+// lane is PALETTE_LANE_ALIGN-byte aligned and padded to a multiple of
+// PALETTE_LANE_WIDTH entries with colors no pixel can be nearest to.
+#define PALETTE_LANE_WIDTH 16
+#define PALETTE_LANE_ALIGN 64
+
+typedef struct {
+    int32_t* r;
+    int32_t* g;
+    int32_t* b;
+    int count;
+    int capacity;
+    void* storage;
+} PaletteLanes;
+
+// Incremental octree quantizer backed by a fixed-size node pool
+typedef struct OctreeQuantizer OctreeQuantizer;
+#define OCTREE_DEFAULT_POOL_SIZE 4096
+
+typedef enum {
+    CONVERT_PRESERVE,  // sample each block, keep original colors
+    CONVERT_ADAPTIVE,  // reduce to an adaptive palette of max_colors
+    CONVERT_PALETTE    // map to the predefined 8-bit palette
+} ConvertMode;
+
+// How a block's color is taken from the input
+typedef enum {
+    SAMPLE_CENTER,   // center pixel; palette modes always average their cells
+    SAMPLE_AVERAGE   // mean of every pixel in the block, from a summed-area table
+} SampleMode;
+
+typedef enum {
+    QUANTIZER_MEDIAN_CUT,
+    QUANTIZER_OCTREE
+} QuantizerType;
+
+typedef struct {
+    ConvertMode mode;
+    int pixel_size;
+    int max_colors;
+    QuantizerType quantizer;
+    int kmeans_iterations;    // 0 disables k-means palette refinement
+    double kmeans_threshold;  // stop once no centroid moves further than this
+    int compact;              // emit one pixel per block instead of full size
+    SampleMode sample;
+} ConvertOptions;
+
+// Per-channel running sums of an image, (width + 1) x (height + 1) entries
+// with a zero first row and column. Rows are split into bands of band_rows
+// that are summed independently; the true sum at a row is its band-local
+// entry plus the band's carry row. Entries wrap modulo 2^32, which keeps
+// block sums exact for blocks of up to SAT_MAX_AREA pixels.
+#define SAT_MAX_AREA (1 << 24)
+
+typedef struct {
+    uint32_t* sums;
+    uint32_t* carries;
+    int width;
+    int height;
+    int channels;
+    int band_rows;
+} SummedAreaTable;
+
+// Input files of a batch run and the output path for each
+typedef struct {
+    char** inputs;
+    char** outputs;
+    int count;
+} BatchJob;
+
+// Stages of the batch pipeline. Each stage takes ownership of the item it
+// is given and signals failure by returning NULL (or 0 for encode).
+typedef struct {
+    void* (*decode)(const char* input, void* context);
+    void* (*convert)(void* decoded, void* context);
+    int (*encode)(void* converted, const char* output, void* context);
+} BatchStages;
+
+// Workers per batch stage and the cap on images between decode and the end
+// of encode; 0 picks a default from the thread count
+typedef struct {
+    int decode_workers;
+    int convert_workers;
+    int encode_workers;
+    int max_in_flight;
+} PipelineConfig;
+
+typedef void (*ParallelTask)(void* context, int start, int end, int worker);
+
+// Supplies up to capacity compressed bytes; returns 0 at the end of the data
+typedef size_t (*InflateSource)(void* context, uint8_t* buffer, size_t capacity);
+typedef struct Inflater Inflater;
+
+// Incremental zlib compressor and PNG writer for output produced in bands
+typedef struct DeflateStream DeflateStream;
+typedef struct PngStream PngStream;
+
+// Decodes an image from disk a few rows at a time (PNG and binary PPM/PGM)
+typedef struct ImageReaderState ImageReaderState;
+
+typedef struct {
+    int width;
+    int height;
+    int channels;
+    int rows_read;
+    ImageReaderState* state;
+} ImageReader;
+
+// Repeats each of count pixels (in_step bytes apart) a fixed number of times
+typedef void (*BlockFillKernel)(const uint8_t* in, int in_step, uint8_t* out, int count);
+
 Image* load_image(const char* filename);
 int save_image(const char* filename, const Image* img);
+int save_image_with_scale(const char* filename, const Image* img, int scale);
+int write_png(const char* filename, const Image* img, int scale);
+void set_png_options(int compression_level, PngFilter filter);
+uint8_t* zlib_compress(const uint8_t* data, size_t length, int level, size_t* out_length);
+uint32_t adler32_update(uint32_t adler, const uint8_t* data, size_t length);
+Inflater* create_inflater(InflateSource source, void* context);
+size_t inflate_read(Inflater* inflater, uint8_t* out, size_t length);
+int inflater_failed(const Inflater* inflater);
+void free_inflater(Inflater* inflater);
+DeflateStream* create_deflate_stream(int level);
+uint8_t* deflate_stream_write(DeflateStream* stream, const uint8_t* data, size_t length, int final,
+                              size_t* out_length);
+void free_deflate_stream(DeflateStream* stream);
+PngStream* open_png_stream(const char* filename, int width, int height, int channels, int scale);
+int write_png_stream_rows(PngStream* stream, const uint8_t* rows, int count);
+int close_png_stream(PngStream* stream);
+ImageReader* open_image_reader(const char* filename);
+int read_image_rows(ImageReader* reader, uint8_t* rows, int count);
+void close_image_reader(ImageReader* reader);
+int write_indexed_png(const char* filename, const uint8_t* indices, int width, int height,
+                      const Color* colors, const uint8_t* alpha, int color_count, int scale);
 void free_image(Image* img);
 Image* resize_image(const Image* src, int new_width, int new_height);
-Image* resize_nearest_neighbor(const Image* src, int new_width, int new_height);
+int* create_box_edges(int size, int count);
+Image* box_reduce_image(const Image* src, int new_width, int new_height);
+Image* box_reduce_cells(const Image* src, const int* x_edges, int grid_width, const int* y_edges, int grid_height);
+const char* box_reduce_kernel_name(void);
+BlockFillKernel find_block_fill_kernel(int factor, int channels);
 Palette* create_palette(int capacity);
 void free_palette(Palette* palette);
 void add_color_to_palette(Palette* palette, uint8_t r, uint8_t g, uint8_t b);
+int build_palette_lut(Palette* palette);
+void free_palette_lut(PaletteLut* lut);
+PaletteLanes* create_palette_lanes(const Palette* palette);
+void free_palette_lanes(PaletteLanes* lanes);
+int palette_lanes_nearest(const PaletteLanes* lanes, uint8_t r, uint8_t g, uint8_t b);
+const char* palette_search_kernel_name(void);
 Image* quantize_colors(const Image* src, const Palette* palette);
+IndexedImage* create_indexed_image(int width, int height, const Palette* palette, int has_alpha);
+void free_indexed_image(IndexedImage* img);
+Image* indexed_to_image(const IndexedImage* img);
+int save_indexed_image(const char* filename, const IndexedImage* img, int scale);
+Palette* create_median_cut_palette(const Image* img, int max_colors);
+OctreeQuantizer* create_octree_quantizer(int max_colors, int pool_size);
+void free_octree_quantizer(OctreeQuantizer* octree);
+void octree_add_color(OctreeQuantizer* octree, uint8_t r, uint8_t g, uint8_t b);
+void octree_add_image(OctreeQuantizer* octree, const Image* img);
+Palette* octree_build_palette(OctreeQuantizer* octree);
+Palette* create_octree_palette(const Image* img, int max_colors);
+int refine_palette_kmeans(Palette* palette, const Image* img, int max_iterations, double threshold);
+void init_convert_options(ConvertOptions* options);
+Image* convert_image(const Image* src, const ConvertOptions* options);
+IndexedImage* convert_image_indexed(const Image* src, const ConvertOptions* options);
+Image* create_low_res_image(const Image* src, int pixel_size);
+IndexedImage* convert_low_res_indexed(const Image* low_res, int width, int height, const ConvertOptions* options);
 Image* convert_to_pixel_art(const Image* src, int pixel_size, int max_colors);
 Image* convert_to_pixel_art_with_palette(const Image* src, int pixel_size);
 Image* convert_to_pixel_art_preserve_colors(const Image* src, int pixel_size);
+Image* convert_table_preserve_colors(const SummedAreaTable* table, const ConvertOptions* options);
+Image* create_low_res_from_table(const SummedAreaTable* table, int pixel_size);
+SummedAreaTable* create_summed_area_table(const Image* src);
+void free_summed_area_table(SummedAreaTable* table);
+void summed_area_mean(const SummedAreaTable* table, int x0, int y0, int x1, int y1, uint8_t* out);
+Image* summed_area_cells(const SummedAreaTable* table, const int* x_edges, int grid_width,
+                         const int* y_edges, int grid_height);
+int convert_stream_preserve_colors(ImageReader* reader, const ConvertOptions* options, const char* output_file);
 void print_image_info(const Image* img);
+int get_thread_count(void);
+void set_thread_count(int count);
+void set_worker_budget(int workers);
+double now_seconds(void);
+int parallel_worker_count(int count);
+int parallel_for(int count, int workers, ParallelTask task, void* context);
+BatchJob* create_batch_job(const char* source, const char* output_dir);
+void free_batch_job(BatchJob* job);
+void init_pipeline_config(PipelineConfig* config);
+int run_batch_job(const BatchJob* job, const BatchStages* stages, void* context, const PipelineConfig* config);
 double color_distance(uint8_t r1, uint8_t g1, uint8_t b1, uint8_t r2, uint8_t g2, uint8_t b2);
+int color_distance_squared(uint8_t r1, uint8_t g1, uint8_t b1, uint8_t r2, uint8_t g2, uint8_t b2);
 Color find_closest_color(uint8_t r, uint8_t g, uint8_t b, const Palette* palette);
 
 #endif
@@ -0,0 +1,649 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../include/pixel_art.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+// Extensions picked up when scanning a directory; list files may name
+// anything stb_image can decode
+static const char* image_extensions[] = {
+    "jpg", "jpeg", "png", "bmp", "tga", "psd", "gif", "hdr", "pic", "pnm", "ppm", "pgm", NULL
+};
+
+static int has_image_extension(const char* name) {
+    const char* ext = strrchr(name, '.');
+    if (!ext || ext == name) {
+        return 0;
+    }
+    ext++;
+
+    for (int i = 0; image_extensions[i]; i++) {
+        const char* a = ext;
+        const char* b = image_extensions[i];
+        while (*a && tolower((unsigned char)*a) == *b) {
+            a++;
+            b++;
+        }
+        if (*a == '\0' && *b == '\0') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static char* join_path(const char* dir, const char* name, const char* suffix) {
+    size_t dir_length = strlen(dir);
+    int needs_slash = dir_length > 0 && dir[dir_length - 1] != '/';
+    size_t length = dir_length + needs_slash + strlen(name) + strlen(suffix) + 1;
+
+    char* path = malloc(length);
+    if (path) {
+        snprintf(path, length, "%s%s%s%s", dir, needs_slash ? "/" : "", name, suffix);
+    }
+    return path;
+}
+
+// output_dir/<input file name without extension>.png
+static char* output_path_for(const char* output_dir, const char* input) {
+    const char* name = strrchr(input, '/');
+    name = name ? name + 1 : input;
+
+    char* stem = strdup(name);
+    if (!stem) {
+        return NULL;
+    }
+    char* ext = strrchr(stem, '.');
+    if (ext && ext != stem) {
+        *ext = '\0';
+    }
+
+    char* path = join_path(output_dir, stem, ".png");
+    free(stem);
+    return path;
+}
+
+static int add_input(BatchJob* job, int* capacity, char* path) {
+    if (!path) {
+        return 0;
+    }
+    if (job->count == *capacity) {
+        int new_capacity = *capacity ? *capacity * 2 : 64;
+        char** inputs = realloc(job->inputs, new_capacity * sizeof(char*));
+        if (!inputs) {
+            free(path);
+            return 0;
+        }
+        job->inputs = inputs;
+        *capacity = new_capacity;
+    }
+    job->inputs[job->count++] = path;
+    return 1;
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static int scan_directory(BatchJob* job, const char* dir) {
+    DIR* handle = opendir(dir);
+    if (!handle) {
+        fprintf(stderr, "Error: failed to open directory '%s'\n", dir);
+        return 0;
+    }
+
+    int capacity = 0;
+    struct dirent* entry;
+    while ((entry = readdir(handle)) != NULL) {
+        if (entry->d_name[0] == '.' || !has_image_extension(entry->d_name)) {
+            continue;
+        }
+
+        char* path = join_path(dir, entry->d_name, "");
+        struct stat st;
+        if (path && (stat(path, &st) != 0 || !S_ISREG(st.st_mode))) {
+            free(path);
+            continue;
+        }
+        if (!add_input(job, &capacity, path)) {
+            fprintf(stderr, "Error: failed to allocate memory for batch inputs\n");
+            closedir(handle);
+            return 0;
+        }
+    }
+    closedir(handle);
+
+    // readdir order is arbitrary; sorted input keeps runs reproducible
+    if (job->count > 1) {
+        qsort(job->inputs, job->count, sizeof(char*), compare_paths);
+    }
+    return 1;
+}
+
+// One path per line; blank lines and lines starting with '#' are skipped
+static int read_list_file(BatchJob* job, const char* list_file) {
+    FILE* file = fopen(list_file, "r");
+    if (!file) {
+        fprintf(stderr, "Error: failed to open list file '%s'\n", list_file);
+        return 0;
+    }
+
+    int capacity = 0;
+    char* line = NULL;
+    size_t line_capacity = 0;
+    int result = 1;
+    while (getline(&line, &line_capacity, file) != -1) {
+        size_t length = strlen(line);
+        while (length > 0 && isspace((unsigned char)line[length - 1])) {
+            line[--length] = '\0';
+        }
+        if (length == 0 || line[0] == '#') {
+            continue;
+        }
+        if (!add_input(job, &capacity, strdup(line))) {
+            fprintf(stderr, "Error: failed to allocate memory for batch inputs\n");
+            result = 0;
+            break;
+        }
+    }
+
+    free(line);
+    fclose(file);
+    return result;
+}
+
+static int ensure_directory(const char* dir) {
+    struct stat st;
+    if (stat(dir, &st) == 0) {
+        if (!S_ISDIR(st.st_mode)) {
+            fprintf(stderr, "Error: '%s' is not a directory\n", dir);
+            return 0;
+        }
+        return 1;
+    }
+    if (mkdir(dir, 0755) != 0) {
+        fprintf(stderr, "Error: failed to create output directory '%s'\n", dir);
+        return 0;
+    }
+    return 1;
+}
+
+// Two inputs with the same name but different extensions or directories
+// would silently overwrite each other's output
+static int check_unique_outputs(const BatchJob* job) {
+    char** sorted = malloc(job->count * sizeof(char*));
+    if (!sorted) {
+        fprintf(stderr, "Error: failed to allocate memory for batch outputs\n");
+        return 0;
+    }
+    memcpy(sorted, job->outputs, job->count * sizeof(char*));
+    qsort(sorted, job->count, sizeof(char*), compare_paths);
+
+    int result = 1;
+    for (int i = 1; i < job->count; i++) {
+        if (strcmp(sorted[i - 1], sorted[i]) == 0) {
+            fprintf(stderr, "Error: several inputs would be written to '%s'\n", sorted[i]);
+            result = 0;
+            break;
+        }
+    }
+    free(sorted);
+    return result;
+}
+
+BatchJob* create_batch_job(const char* source, const char* output_dir) {
+    if (!source || !output_dir) {
+        fprintf(stderr, "Error: invalid parameters for create_batch_job\n");
+        return NULL;
+    }
+
+    BatchJob* job = calloc(1, sizeof(BatchJob));
+    if (!job) {
+        fprintf(stderr, "Error: failed to allocate memory for batch job\n");
+        return NULL;
+    }
+
+    struct stat st;
+    int loaded;
+    if (stat(source, &st) != 0) {
+        fprintf(stderr, "Error: batch source '%s' does not exist\n", source);
+        loaded = 0;
+    } else if (S_ISDIR(st.st_mode)) {
+        loaded = scan_directory(job, source);
+    } else {
+        loaded = read_list_file(job, source);
+    }
+
+    if (loaded && job->count == 0) {
+        fprintf(stderr, "Error: no input images found in '%s'\n", source);
+        loaded = 0;
+    }
+    if (!loaded || !ensure_directory(output_dir)) {
+        free_batch_job(job);
+        return NULL;
+    }
+
+    job->outputs = calloc(job->count, sizeof(char*));
+    if (!job->outputs) {
+        fprintf(stderr, "Error: failed to allocate memory for batch outputs\n");
+        free_batch_job(job);
+        return NULL;
+    }
+    for (int i = 0; i < job->count; i++) {
+        job->outputs[i] = output_path_for(output_dir, job->inputs[i]);
+        if (!job->outputs[i]) {
+            fprintf(stderr, "Error: failed to allocate memory for batch outputs\n");
+            free_batch_job(job);
+            return NULL;
+        }
+    }
+
+    if (!check_unique_outputs(job)) {
+        free_batch_job(job);
+        return NULL;
+    }
+    return job;
+}
+
+void free_batch_job(BatchJob* job) {
+    if (!job) {
+        return;
+    }
+    for (int i = 0; i < job->count; i++) {
+        free(job->inputs[i]);
+        if (job->outputs) {
+            free(job->outputs[i]);
+        }
+    }
+    free(job->inputs);
+    free(job->outputs);
+    free(job);
+}
+
+enum {
+    STAGE_DECODE,
+    STAGE_CONVERT,
+    STAGE_ENCODE,
+    STAGE_COUNT
+};
+
+static const char* stage_names[STAGE_COUNT] = {"decode", "convert", "encode"};
+
+// Bounded FIFO of (file index, item) pairs between two stages
+typedef struct {
+    int* indices;
+    void** items;
+    int capacity;
+    int head;
+    int count;
+    int closed;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} StageQueue;
+
+static int init_stage_queue(StageQueue* queue, int capacity) {
+    memset(queue, 0, sizeof(*queue));
+    queue->indices = malloc(capacity * sizeof(int));
+    queue->items = malloc(capacity * sizeof(void*));
+    if (!queue->indices || !queue->items) {
+        free(queue->indices);
+        free(queue->items);
+        return 0;
+    }
+    queue->capacity = capacity;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    return 1;
+}
+
+static void destroy_stage_queue(StageQueue* queue) {
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->indices);
+    free(queue->items);
+}
+
+static void stage_queue_push(StageQueue* queue, int index, void* item) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->capacity) {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+    int tail = (queue->head + queue->count) % queue->capacity;
+    queue->indices[tail] = index;
+    queue->items[tail] = item;
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// Blocks until an item is available; returns 0 once the queue is closed
+// and drained
+static int stage_queue_pop(StageQueue* queue, int* index, void** item) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && !queue->closed) {
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    }
+    if (queue->count == 0) {
+        pthread_mutex_unlock(&queue->lock);
+        return 0;
+    }
+    *index = queue->indices[queue->head];
+    *item = queue->items[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return 1;
+}
+
+static void close_stage_queue(StageQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+typedef struct {
+    const BatchJob* job;
+    const BatchStages* stages;
+    void* context;
+    StageQueue to_convert;
+    StageQueue to_encode;
+    int worker_budget;  // parallel_for workers each pipeline worker may use
+
+    // Guards everything below
+    pthread_mutex_t lock;
+    pthread_cond_t slot_free;
+    int next_file;
+    int stopped;    // no more files are handed to decode workers
+    int in_flight;  // decoded but not yet encoded or dropped
+    int max_in_flight;
+    int peak_in_flight;
+    int active[STAGE_COUNT];  // workers still running, per stage
+    int completed;
+    int failures;
+} Pipeline;
+
+typedef struct {
+    Pipeline* pipeline;
+    int stage;
+    double busy_seconds;
+    pthread_t thread;
+} PipelineWorker;
+
+// Called once per file when it leaves the pipeline, successfully or not
+static void finish_file(Pipeline* p, int index, int converted) {
+    pthread_mutex_lock(&p->lock);
+    p->in_flight--;
+    p->completed++;
+    if (!converted) {
+        p->failures++;
+    }
+    printf("[%d/%d] %s %s -> %s\n", p->completed, p->job->count, converted ? "Converted" : "FAILED",
+           p->job->inputs[index], p->job->outputs[index]);
+    pthread_cond_signal(&p->slot_free);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// The last worker of a stage closes the queue it feeds
+static void finish_stage_worker(Pipeline* p, int stage) {
+    pthread_mutex_lock(&p->lock);
+    int remaining = --p->active[stage];
+    pthread_mutex_unlock(&p->lock);
+
+    if (remaining == 0 && stage == STAGE_DECODE) {
+        close_stage_queue(&p->to_convert);
+    } else if (remaining == 0 && stage == STAGE_CONVERT) {
+        close_stage_queue(&p->to_encode);
+    }
+}
+
+// Claims the next file once an in-flight slot is free; -1 when none are left
+static int claim_file(Pipeline* p) {
+    pthread_mutex_lock(&p->lock);
+    while (p->in_flight >= p->max_in_flight && p->next_file < p->job->count && !p->stopped) {
+        pthread_cond_wait(&p->slot_free, &p->lock);
+    }
+    int index = -1;
+    if (p->next_file < p->job->count && !p->stopped) {
+        index = p->next_file++;
+        p->in_flight++;
+        if (p->in_flight > p->peak_in_flight) {
+            p->peak_in_flight = p->in_flight;
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+    return index;
+}
+
+static void run_decode_worker(PipelineWorker* worker) {
+    Pipeline* p = worker->pipeline;
+    int index;
+    while ((index = claim_file(p)) >= 0) {
+        double start = now_seconds();
+        void* decoded = p->stages->decode(p->job->inputs[index], p->context);
+        worker->busy_seconds += now_seconds() - start;
+
+        if (decoded) {
+            stage_queue_push(&p->to_convert, index, decoded);
+        } else {
+            finish_file(p, index, 0);
+        }
+    }
+}
+
+static void run_convert_worker(PipelineWorker* worker) {
+    Pipeline* p = worker->pipeline;
+    int index;
+    void* decoded;
+    while (stage_queue_pop(&p->to_convert, &index, &decoded)) {
+        double start = now_seconds();
+        void* converted = p->stages->convert(decoded, p->context);
+        worker->busy_seconds += now_seconds() - start;
+
+        if (converted) {
+            stage_queue_push(&p->to_encode, index, converted);
+        } else {
+            finish_file(p, index, 0);
+        }
+    }
+}
+
+static void run_encode_worker(PipelineWorker* worker) {
+    Pipeline* p = worker->pipeline;
+    int index;
+    void* converted;
+    while (stage_queue_pop(&p->to_encode, &index, &converted)) {
+        double start = now_seconds();
+        int encoded = p->stages->encode(converted, p->job->outputs[index], p->context);
+        worker->busy_seconds += now_seconds() - start;
+        finish_file(p, index, encoded);
+    }
+}
+
+static void* run_pipeline_worker(void* arg) {
+    PipelineWorker* worker = arg;
+    set_worker_budget(worker->pipeline->worker_budget);
+    switch (worker->stage) {
+        case STAGE_DECODE:
+            run_decode_worker(worker);
+            break;
+        case STAGE_CONVERT:
+            run_convert_worker(worker);
+            break;
+        default:
+            run_encode_worker(worker);
+            break;
+    }
+    finish_stage_worker(worker->pipeline, worker->stage);
+    set_worker_budget(0);
+    return NULL;
+}
+
+void init_pipeline_config(PipelineConfig* config) {
+    config->decode_workers = 0;
+    config->convert_workers = 0;
+    config->encode_workers = 0;
+    config->max_in_flight = 0;
+}
+
+// Conversion usually dominates, so it gets most of the threads; decode and
+// encode each get a quarter. No stage gets more workers than files.
+static void resolve_pipeline_config(PipelineConfig* config, int thread_count, int file_count) {
+    int share = thread_count / 4 > 0 ? thread_count / 4 : 1;
+    if (config->decode_workers <= 0) config->decode_workers = share;
+    if (config->encode_workers <= 0) config->encode_workers = share;
+    if (config->convert_workers <= 0) {
+        int rest = thread_count - config->decode_workers - config->encode_workers;
+        config->convert_workers = rest > 0 ? rest : 1;
+    }
+
+    if (config->decode_workers > file_count) config->decode_workers = file_count;
+    if (config->convert_workers > file_count) config->convert_workers = file_count;
+    if (config->encode_workers > file_count) config->encode_workers = file_count;
+
+    // Enough decoded images to keep every convert and encode worker busy
+    // while the next ones are decoded
+    if (config->max_in_flight <= 0) {
+        config->max_in_flight = 2 * (config->convert_workers + config->encode_workers);
+    }
+}
+
+static void print_stage_report(const PipelineWorker* workers, int worker_count, const int* stage_workers,
+                               double wall_seconds, const Pipeline* p) {
+    printf("\nStage     Workers   Busy (s)  Utilization\n");
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        double busy = 0.0;
+        for (int i = 0; i < worker_count; i++) {
+            if (workers[i].stage == stage) busy += workers[i].busy_seconds;
+        }
+        double capacity = wall_seconds * stage_workers[stage];
+        printf("%-9s %7d %10.2f %11.1f%%\n", stage_names[stage], stage_workers[stage], busy,
+               capacity > 0 ? 100.0 * busy / capacity : 0.0);
+    }
+    printf("Peak images in flight: %d of %d\n", p->peak_in_flight, p->max_in_flight);
+}
+
+// Converts every input through a three stage pipeline: decode, convert and
+// encode workers connected by bounded queues. A file holds an in-flight
+// slot from decode until it is encoded or fails, so decoded images never
+// pile up faster than later stages drain them. Files are the unit of
+// parallelism, so per-image work only gets its share of the threads.
+// Returns the number of files that converted successfully.
+int run_batch_job(const BatchJob* job, const BatchStages* stages, void* context, const PipelineConfig* config) {
+    if (!job || !stages || !stages->decode || !stages->convert || !stages->encode) {
+        fprintf(stderr, "Error: invalid parameters for run_batch_job\n");
+        return 0;
+    }
+
+    PipelineConfig resolved;
+    if (config) {
+        resolved = *config;
+    } else {
+        init_pipeline_config(&resolved);
+    }
+    int thread_count = get_thread_count();
+    resolve_pipeline_config(&resolved, thread_count, job->count);
+
+    int stage_workers[STAGE_COUNT] = {resolved.decode_workers, resolved.convert_workers, resolved.encode_workers};
+    int worker_count = stage_workers[STAGE_DECODE] + stage_workers[STAGE_CONVERT] + stage_workers[STAGE_ENCODE];
+
+    Pipeline p = {0};
+    p.job = job;
+    p.stages = stages;
+    p.context = context;
+    p.max_in_flight = resolved.max_in_flight;
+    memcpy(p.active, stage_workers, sizeof(stage_workers));
+
+    PipelineWorker* workers = calloc(worker_count, sizeof(PipelineWorker));
+    int queues_ready = init_stage_queue(&p.to_convert, p.max_in_flight);
+    if (queues_ready && !init_stage_queue(&p.to_encode, p.max_in_flight)) {
+        destroy_stage_queue(&p.to_convert);
+        queues_ready = 0;
+    }
+    if (!workers || !queues_ready) {
+        fprintf(stderr, "Error: failed to allocate memory for batch pipeline\n");
+        free(workers);
+        if (queues_ready) {
+            destroy_stage_queue(&p.to_convert);
+            destroy_stage_queue(&p.to_encode);
+        }
+        return 0;
+    }
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_cond_init(&p.slot_free, NULL);
+
+    // Every pipeline worker may be inside parallel_for at the same time, so
+    // each gets an equal share of the threads instead of all of them
+    p.worker_budget = thread_count / worker_count > 0 ? thread_count / worker_count : 1;
+
+    printf("Converting %d images: %d decode, %d convert, %d encode workers, at most %d images in flight\n",
+           job->count, stage_workers[STAGE_DECODE], stage_workers[STAGE_CONVERT], stage_workers[STAGE_ENCODE],
+           p.max_in_flight);
+    double start = now_seconds();
+
+    // Consumers start before producers. Worker 0 is the first encode worker
+    // and runs on the calling thread; a worker that fails to start counts as
+    // finished, and files left unclaimed are converted inline afterwards.
+    int order[STAGE_COUNT] = {STAGE_ENCODE, STAGE_CONVERT, STAGE_DECODE};
+    int* started = calloc(worker_count, sizeof(int));
+    int next_worker = 0;
+    for (int o = 0; o < STAGE_COUNT; o++) {
+        int stage = order[o];
+        int stage_started = 0;
+        for (int i = 0; i < stage_workers[stage]; i++, next_worker++) {
+            PipelineWorker* worker = &workers[next_worker];
+            worker->pipeline = &p;
+            worker->stage = stage;
+            if (next_worker == 0) {
+                stage_started++;
+                continue;
+            }
+            if (started && pthread_create(&worker->thread, NULL, run_pipeline_worker, worker) == 0) {
+                started[next_worker] = 1;
+                stage_started++;
+            } else {
+                finish_stage_worker(&p, stage);
+            }
+        }
+        if (stage == STAGE_CONVERT && stage_started == 0) {
+            // Nothing would drain decoded images; leave every file to the
+            // inline fallback
+            pthread_mutex_lock(&p.lock);
+            p.stopped = 1;
+            pthread_mutex_unlock(&p.lock);
+        }
+    }
+
+    run_pipeline_worker(&workers[0]);
+    for (int i = 1; i < worker_count; i++) {
+        if (started && started[i]) {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
+
+    for (int index = p.next_file; index < job->count; index++) {
+        p.in_flight++;
+        void* item = stages->decode(job->inputs[index], context);
+        if (item) item = stages->convert(item, context);
+        finish_file(&p, index, item && stages->encode(item, job->outputs[index], context));
+    }
+
+    double wall_seconds = now_seconds() - start;
+
+    int converted = job->count - p.failures;
+    print_stage_report(workers, worker_count, stage_workers, wall_seconds, &p);
+    printf("Batch complete: %d of %d images converted in %.2f s (%.1f images/s)\n",
+           converted, job->count, wall_seconds, wall_seconds > 0 ? converted / wall_seconds : 0.0);
+
+    free(started);
+    free(workers);
+    destroy_stage_queue(&p.to_convert);
+    destroy_stage_queue(&p.to_encode);
+    pthread_mutex_destroy(&p.lock);
+    pthread_cond_destroy(&p.slot_free);
+    return converted;
+}
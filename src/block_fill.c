@@ -0,0 +1,43 @@
+#include "../include/pixel_art.h"
+
+// Each kernel writes count pixels, repeating every one FACTOR times. Source
+// pixels are in_step bytes apart, so the same kernel serves contiguous rows
+// (upscaling) and one-sample-per-block rows (block sampling). With FACTOR
+// and CHANNELS known at compile time the inner loop becomes straight-line
+// stores of a pixel held in registers.
+#define DEFINE_BLOCK_FILL_KERNEL(FACTOR, CHANNELS)                                       \
+    static void fill_##FACTOR##_##CHANNELS(const uint8_t* in, int in_step,               \
+                                          uint8_t* out, int count) {                     \
+        for (int x = 0; x < count; x++, in += in_step) {                                 \
+            uint8_t pixel[CHANNELS];                                                     \
+            memcpy(pixel, in, CHANNELS);                                                 \
+            for (int i = 0; i < FACTOR; i++, out += CHANNELS) {                          \
+                memcpy(out, pixel, CHANNELS);                                            \
+            }                                                                            \
+        }                                                                                \
+    }
+
+#define DEFINE_BLOCK_FILL_KERNELS(FACTOR) \
+    DEFINE_BLOCK_FILL_KERNEL(FACTOR, 3)   \
+    DEFINE_BLOCK_FILL_KERNEL(FACTOR, 4)
+
+DEFINE_BLOCK_FILL_KERNELS(2)
+DEFINE_BLOCK_FILL_KERNELS(4)
+DEFINE_BLOCK_FILL_KERNELS(8)
+DEFINE_BLOCK_FILL_KERNELS(16)
+DEFINE_BLOCK_FILL_KERNELS(32)
+
+BlockFillKernel find_block_fill_kernel(int factor, int channels) {
+    if (channels != 3 && channels != 4) {
+        return NULL;
+    }
+
+    switch (factor) {
+        case 2:  return channels == 3 ? fill_2_3 : fill_2_4;
+        case 4:  return channels == 3 ? fill_4_3 : fill_4_4;
+        case 8:  return channels == 3 ? fill_8_3 : fill_8_4;
+        case 16: return channels == 3 ? fill_16_3 : fill_16_4;
+        case 32: return channels == 3 ? fill_32_3 : fill_32_4;
+        default: return NULL;
+    }
+}
@@ -0,0 +1,247 @@
+#include "../include/pixel_art.h"
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BOX_REDUCE_X86 1
+#include <immintrin.h>
+#endif
+
+// Integer box filter for shrinking an image to its cell grid. Each output
+// pixel is the rounded mean of the input pixels in its box, computed with
+// integer sums only: the rows of a cell row are added into one row of
+// 32-bit column sums by a vector kernel, then each cell adds up its
+// columns. Boxes of one width share a fixed-width loop; boxes of other
+// widths, such as a ragged last block, take a generic loop.
+
+typedef void (*RowAccumulateKernel)(const uint8_t* row, uint32_t* sums, size_t count);
+
+// Edges of count equal boxes spanning size pixels: box i covers
+// [edges[i], edges[i + 1]). Boxes are size / count wide when that divides.
+int* create_box_edges(int size, int count) {
+    int* edges = malloc((count + 1) * sizeof(int));
+    if (!edges) {
+        fprintf(stderr, "Error: failed to allocate memory for box edges\n");
+        return NULL;
+    }
+    for (int i = 0; i <= count; i++) {
+        edges[i] = (int)((int64_t)i * size / count);
+    }
+    return edges;
+}
+
+static void accumulate_scalar(const uint8_t* row, uint32_t* sums, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        sums[i] += row[i];
+    }
+}
+
+#ifdef BOX_REDUCE_X86
+
+__attribute__((target("sse2")))
+static void accumulate_sse2(const uint8_t* row, uint32_t* sums, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(row + i));
+        __m128i low = _mm_unpacklo_epi8(bytes, zero);
+        __m128i high = _mm_unpackhi_epi8(bytes, zero);
+        __m128i* out = (__m128i*)(sums + i);
+        _mm_storeu_si128(out, _mm_add_epi32(_mm_loadu_si128(out), _mm_unpacklo_epi16(low, zero)));
+        _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), _mm_unpackhi_epi16(low, zero)));
+        _mm_storeu_si128(out + 2, _mm_add_epi32(_mm_loadu_si128(out + 2), _mm_unpacklo_epi16(high, zero)));
+        _mm_storeu_si128(out + 3, _mm_add_epi32(_mm_loadu_si128(out + 3), _mm_unpackhi_epi16(high, zero)));
+    }
+    accumulate_scalar(row + i, sums + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void accumulate_avx2(const uint8_t* row, uint32_t* sums, size_t count) {
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        for (int part = 0; part < 4; part++) {
+            __m128i bytes = _mm_loadl_epi64((const __m128i*)(row + i + part * 8));
+            __m256i* out = (__m256i*)(sums + i + part * 8);
+            _mm256_storeu_si256(out, _mm256_add_epi32(_mm256_loadu_si256(out), _mm256_cvtepu8_epi32(bytes)));
+        }
+    }
+    accumulate_scalar(row + i, sums + i, count - i);
+}
+
+#endif
+
+static pthread_once_t accumulate_kernel_once = PTHREAD_ONCE_INIT;
+static RowAccumulateKernel accumulate_kernel = accumulate_scalar;
+static const char* accumulate_kernel_name = "scalar";
+
+static void select_accumulate_kernel(void) {
+#ifdef BOX_REDUCE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        accumulate_kernel = accumulate_avx2;
+        accumulate_kernel_name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        accumulate_kernel = accumulate_sse2;
+        accumulate_kernel_name = "sse2";
+    }
+#endif
+}
+
+const char* box_reduce_kernel_name(void) {
+    pthread_once(&accumulate_kernel_once, select_accumulate_kernel);
+    return accumulate_kernel_name;
+}
+
+typedef struct {
+    const Image* src;
+    Image* dst;
+    const int* x_edges;
+    const int* y_edges;
+    int failed;
+} BoxReduceContext;
+
+// Boxes up to this many pixels divide by multiplying with a reciprocal
+#define RECIPROCAL_MAX_AREA (1 << 16)
+
+// Rounded means of equal-width boxes; the width is a constant in the
+// inlined copies so the inner loops unroll. A box sum is below 256 * area,
+// and with shift >= 8 + 2 * log2(area) the rounded-up reciprocal gives the
+// exact quotient for every such sum, without a division per pixel.
+static inline void reduce_uniform_row(const uint32_t* sums, uint8_t* out, int cells, int box_width,
+                                      int channels, uint64_t area) {
+    int shift = 8;
+    while (((uint64_t)1 << (shift - 8)) < area * area) shift++;
+    uint64_t reciprocal = area < RECIPROCAL_MAX_AREA ? ((uint64_t)1 << shift) / area + 1 : 0;
+
+    for (int cell = 0; cell < cells; cell++) {
+        const uint32_t* column = sums + (size_t)cell * box_width * channels;
+        for (int c = 0; c < channels; c++) {
+            uint64_t total = area / 2;
+            for (int x = 0; x < box_width; x++) {
+                total += column[x * channels + c];
+            }
+            out[cell * channels + c] = (uint8_t)(reciprocal ? (total * reciprocal) >> shift : total / area);
+        }
+    }
+}
+
+// Generic path for boxes whose widths vary along the row
+static void reduce_ragged_row(const uint32_t* sums, uint8_t* out, const int* x_edges, int cells, int channels,
+                              int box_height) {
+    for (int cell = 0; cell < cells; cell++) {
+        int x0 = x_edges[cell];
+        int x1 = x_edges[cell + 1];
+        uint64_t area = (uint64_t)(x1 - x0) * box_height;
+        for (int c = 0; c < channels; c++) {
+            uint64_t total = 0;
+            for (int x = x0; x < x1; x++) {
+                total += sums[(size_t)x * channels + c];
+            }
+            out[cell * channels + c] = (uint8_t)((total + area / 2) / area);
+        }
+    }
+}
+
+static void reduce_cell_rows(void* context, int start, int end, int worker) {
+    BoxReduceContext* ctx = context;
+    const Image* src = ctx->src;
+    Image* dst = ctx->dst;
+    int channels = src->channels;
+    size_t count = (size_t)src->width * channels;
+    (void)worker;
+
+    uint32_t* sums = malloc(count * sizeof(uint32_t));
+    if (!sums) {
+        ctx->failed = 1;
+        return;
+    }
+
+    // Leading boxes of one width take the fixed-width loop; the rest, such
+    // as a ragged last block, go through the generic path
+    int box_width = ctx->x_edges[1] - ctx->x_edges[0];
+    int uniform = 1;
+    while (uniform < dst->width && ctx->x_edges[uniform + 1] - ctx->x_edges[uniform] == box_width) {
+        uniform++;
+    }
+
+    for (int cell_y = start; cell_y < end; cell_y++) {
+        int y0 = ctx->y_edges[cell_y];
+        int y1 = ctx->y_edges[cell_y + 1];
+        memset(sums, 0, count * sizeof(uint32_t));
+        for (int y = y0; y < y1; y++) {
+            accumulate_kernel(src->data + y * count, sums, count);
+        }
+
+        uint8_t* out = dst->data + (size_t)cell_y * dst->width * channels;
+        int box_height = y1 - y0;
+        if (box_width == 1) {
+            reduce_uniform_row(sums, out, uniform, 1, channels, (uint64_t)box_height);
+        } else if (channels == 3) {
+            reduce_uniform_row(sums, out, uniform, box_width, 3, (uint64_t)box_width * box_height);
+        } else if (channels == 4) {
+            reduce_uniform_row(sums, out, uniform, box_width, 4, (uint64_t)box_width * box_height);
+        } else {
+            uniform = 0;
+        }
+        reduce_ragged_row(sums, out + uniform * channels, ctx->x_edges + uniform, dst->width - uniform, channels,
+                          box_height);
+    }
+
+    free(sums);
+}
+
+// Averages a grid of cells with a box filter. Cell (x, y) covers columns
+// x_edges[x] up to x_edges[x + 1] and rows y_edges[y] up to y_edges[y + 1],
+// like summed_area_cells, and both give the same result.
+Image* box_reduce_cells(const Image* src, const int* x_edges, int grid_width, const int* y_edges, int grid_height) {
+    if (!src || !src->data || !x_edges || !y_edges || grid_width <= 0 || grid_height <= 0 ||
+        x_edges[0] != 0 || x_edges[grid_width] != src->width ||
+        y_edges[0] != 0 || y_edges[grid_height] != src->height) {
+        fprintf(stderr, "Error: invalid parameters for box_reduce_cells\n");
+        return NULL;
+    }
+    pthread_once(&accumulate_kernel_once, select_accumulate_kernel);
+
+    Image* dst = malloc(sizeof(Image));
+    if (dst) {
+        dst->width = grid_width;
+        dst->height = grid_height;
+        dst->channels = src->channels;
+        dst->data = malloc((size_t)grid_width * grid_height * src->channels);
+    }
+    if (!dst || !dst->data) {
+        fprintf(stderr, "Error: failed to allocate memory for reduced image\n");
+        free(dst);
+        return NULL;
+    }
+
+    BoxReduceContext ctx = {src, dst, x_edges, y_edges, 0};
+    parallel_for(grid_height, 0, reduce_cell_rows, &ctx);
+
+    if (ctx.failed) {
+        fprintf(stderr, "Error: failed to allocate memory for reduced image\n");
+        free_image(dst);
+        return NULL;
+    }
+    return dst;
+}
+
+// Shrinks src to new_width x new_height (no larger than src) with a box
+// filter over evenly spread boxes. Unlike resize_image there is no filter
+// setup or float conversion, which matters most for large reduction factors.
+Image* box_reduce_image(const Image* src, int new_width, int new_height) {
+    if (!src || !src->data || new_width <= 0 || new_height <= 0 ||
+        new_width > src->width || new_height > src->height) {
+        fprintf(stderr, "Error: invalid parameters for box_reduce_image\n");
+        return NULL;
+    }
+
+    int* x_edges = create_box_edges(src->width, new_width);
+    int* y_edges = create_box_edges(src->height, new_height);
+    Image* dst = NULL;
+    if (x_edges && y_edges) {
+        dst = box_reduce_cells(src, x_edges, new_width, y_edges, new_height);
+    }
+    free(x_edges);
+    free(y_edges);
+    return dst;
+}
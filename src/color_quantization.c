@@ -17,6 +17,7 @@ Palette* create_palette(int capacity) {
 
     palette->count = 0;
     palette->capacity = capacity;
+    palette->lut = NULL;
     return palette;
 }
 
@@ -25,6 +26,7 @@ void free_palette(Palette* palette) {
         if (palette->colors) {
             free(palette->colors);
         }
+        free_palette_lut(palette->lut);
         free(palette);
     }
 }
@@ -38,42 +40,178 @@ void add_color_to_palette(Palette* palette, uint8_t r, uint8_t g, uint8_t b) {
     palette->colors[palette->count].g = g;
     palette->colors[palette->count].b = b;
     palette->count++;
+
+    // Any previously built lookup table no longer matches the palette
+    free_palette_lut(palette->lut);
+    palette->lut = NULL;
 }
 
 double color_distance(uint8_t r1, uint8_t g1, uint8_t b1, uint8_t r2, uint8_t g2, uint8_t b2) {
+    return sqrt((double)color_distance_squared(r1, g1, b1, r2, g2, b2));
+}
+
+int color_distance_squared(uint8_t r1, uint8_t g1, uint8_t b1, uint8_t r2, uint8_t g2, uint8_t b2) {
     int dr = r1 - r2;
     int dg = g1 - g2;
     int db = b1 - b2;
-    return sqrt(dr*dr + dg*dg + db*db);
+    return dr*dr + dg*dg + db*db;
 }
 
 
+// Nearest palette entry by squared distance. Ordering by squared distance
+// matches ordering by distance, so the search stays in 32-bit integers.
+static int find_closest_index(uint8_t r, uint8_t g, uint8_t b, const Palette* palette) {
+    int min_distance = INT32_MAX;
+    int closest_index = 0;
+
+    for (int i = 0; i < palette->count; i++) {
+        int dr = r - palette->colors[i].r;
+        int dg = g - palette->colors[i].g;
+        int db = b - palette->colors[i].b;
+        int distance = dr * dr + dg * dg + db * db;
+        if (distance < min_distance) {
+            min_distance = distance;
+            closest_index = i;
+        }
+    }
+
+    return closest_index;
+}
+
 Color find_closest_color(uint8_t r, uint8_t g, uint8_t b, const Palette* palette) {
     if (!palette || palette->count == 0) {
         Color default_color = {r, g, b};
         return default_color;
     }
 
-    double min_distance = color_distance(r, g, b, 
-                                       palette->colors[0].r, 
-                                       palette->colors[0].g, 
-                                       palette->colors[0].b);
-    int closest_index = 0;
+    return palette->colors[find_closest_index(r, g, b, palette)];
+}
 
-    for (int i = 1; i < palette->count; i++) {
-        double distance = color_distance(r, g, b,
-                                       palette->colors[i].r,
-                                       palette->colors[i].g,
-                                       palette->colors[i].b);
-        if (distance < min_distance) {
-            min_distance = distance;
-            closest_index = i;
+void free_palette_lut(PaletteLut* lut) {
+    if (lut) {
+        free(lut->offsets);
+        free(lut->candidates);
+        free(lut);
+    }
+}
+
+// Squared distance from every palette entry to the nearest and farthest
+// value of each cell along one axis
+static void measure_axis(const Palette* palette, int axis, int32_t* near, int32_t* far) {
+    const int cell_span = 1 << LUT_SHIFT;
+    for (int cell = 0; cell < LUT_SIZE; cell++) {
+        int lo = cell << LUT_SHIFT;
+        int hi = lo + cell_span - 1;
+        for (int i = 0; i < palette->count; i++) {
+            const Color* color = &palette->colors[i];
+            int v = axis == 0 ? color->r : axis == 1 ? color->g : color->b;
+            int below = v < lo ? lo - v : v > hi ? v - hi : 0;
+            int across = v - lo > hi - v ? v - lo : hi - v;
+            if (across < 0) across = -across;
+            near[cell * palette->count + i] = below * below;
+            far[cell * palette->count + i] = across * across;
+        }
+    }
+}
+
+// Lists the candidates of every LUT_SIZE^3 cell. Some entry is at most
+// limit (the smallest farthest-point distance) from every color in the
+// cell, so an entry whose nearest-point distance exceeds limit is never the
+// nearest one. Keeping entries that tie with limit keeps the lowest index
+// among equally near colors, as the exhaustive search does. Indices are
+// stored as bytes, so the palette must hold between 1 and 256 colors.
+static PaletteLut* create_lut(const Palette* palette) {
+    if (palette->count == 0 || palette->count > 256) {
+        return NULL;
+    }
+
+    int count = palette->count;
+    size_t axis_entries = (size_t)LUT_SIZE * count;
+    int32_t* near = malloc(3 * axis_entries * sizeof(int32_t));
+    int32_t* far = malloc(3 * axis_entries * sizeof(int32_t));
+    int32_t* cell_near = malloc(count * sizeof(int32_t));
+    PaletteLut* lut = calloc(1, sizeof(PaletteLut));
+    size_t capacity = (size_t)LUT_SIZE * LUT_SIZE * LUT_SIZE * 2;
+    if (lut) {
+        lut->offsets = malloc((LUT_SIZE * LUT_SIZE * LUT_SIZE + 1) * sizeof(uint32_t));
+        lut->candidates = malloc(capacity * sizeof(uint32_t));
+    }
+    if (!near || !far || !cell_near || !lut || !lut->offsets || !lut->candidates) {
+        fprintf(stderr, "Error: failed to allocate memory for palette lookup table\n");
+        free(near);
+        free(far);
+        free(cell_near);
+        free_palette_lut(lut);
+        return NULL;
+    }
+
+    for (int axis = 0; axis < 3; axis++) {
+        measure_axis(palette, axis, near + axis * axis_entries, far + axis * axis_entries);
+    }
+
+    size_t used = 0;
+    int cell = 0;
+    for (int r = 0; r < LUT_SIZE; r++) {
+        for (int g = 0; g < LUT_SIZE; g++) {
+            const int32_t* near_r = near + (size_t)r * count;
+            const int32_t* near_g = near + axis_entries + (size_t)g * count;
+            const int32_t* far_r = far + (size_t)r * count;
+            const int32_t* far_g = far + axis_entries + (size_t)g * count;
+            for (int b = 0; b < LUT_SIZE; b++, cell++) {
+                const int32_t* near_b = near + 2 * axis_entries + (size_t)b * count;
+                const int32_t* far_b = far + 2 * axis_entries + (size_t)b * count;
+
+                int32_t limit = INT32_MAX;
+                for (int i = 0; i < count; i++) {
+                    int32_t distance = far_r[i] + far_g[i] + far_b[i];
+                    if (distance < limit) limit = distance;
+                    cell_near[i] = near_r[i] + near_g[i] + near_b[i];
+                }
+
+                if (used + count > capacity) {
+                    capacity *= 2;
+                    uint32_t* grown = realloc(lut->candidates, capacity * sizeof(uint32_t));
+                    if (!grown) {
+                        fprintf(stderr, "Error: failed to allocate memory for palette lookup table\n");
+                        free(near);
+                        free(far);
+                        free(cell_near);
+                        free_palette_lut(lut);
+                        return NULL;
+                    }
+                    lut->candidates = grown;
+                }
+
+                lut->offsets[cell] = (uint32_t)used;
+                for (int i = 0; i < count; i++) {
+                    if (cell_near[i] <= limit) {
+                        const Color* color = &palette->colors[i];
+                        lut->candidates[used++] = (uint32_t)color->r << 24 | (uint32_t)color->g << 16 |
+                                                  (uint32_t)color->b << 8 | (uint32_t)i;
+                    }
+                }
+            }
         }
     }
+    lut->offsets[cell] = (uint32_t)used;
 
-    return palette->colors[closest_index];
+    free(near);
+    free(far);
+    free(cell_near);
+    return lut;
 }
 
+int build_palette_lut(Palette* palette) {
+    if (!palette) {
+        return 0;
+    }
+    if (palette->lut) {
+        return 1;
+    }
+
+    palette->lut = create_lut(palette);
+    return palette->lut != NULL;
+}
 
 Image* quantize_colors(const Image* src, const Palette* palette) {
     if (!src || !src->data || !palette) {
@@ -98,26 +236,522 @@ Image* quantize_colors(const Image* src, const Palette* palette) {
         return NULL;
     }
 
-    for (int i = 0; i < src->width * src->height; i++) {
-        int pixel_idx = i * src->channels;
-        
+    // Nothing to map to: keep the original colors
+    if (palette->count == 0) {
+        memcpy(dst->data, src->data, (size_t)src->width * src->height * src->channels);
+        return dst;
+    }
+
+    // Reuse the palette's table when the caller built one, otherwise build a
+    // temporary one for this call. Without a table (palettes too large for
+    // byte indices) each pixel falls back to the exhaustive search.
+    Palette with_lut = *palette;
+    PaletteLut* lut = palette->lut ? NULL : create_lut(palette);
+    if (lut) {
+        with_lut.lut = lut;
+    }
+
+    size_t pixel_count = (size_t)src->width * src->height;
+    for (size_t i = 0; i < pixel_count; i++) {
+        size_t pixel_idx = i * src->channels;
         uint8_t r = src->data[pixel_idx];
         uint8_t g = src->data[pixel_idx + 1];
         uint8_t b = src->data[pixel_idx + 2];
+        int index = with_lut.lut ? palette_lut_nearest(&with_lut, r, g, b) : find_closest_index(r, g, b, palette);
 
-        Color closest = find_closest_color(r, g, b, palette);
-
-        dst->data[pixel_idx] = closest.r;
-        dst->data[pixel_idx + 1] = closest.g;
-        dst->data[pixel_idx + 2] = closest.b;
+        const Color* closest = &palette->colors[index];
+        dst->data[pixel_idx] = closest->r;
+        dst->data[pixel_idx + 1] = closest->g;
+        dst->data[pixel_idx + 2] = closest->b;
 
         if (src->channels == 4) {
             dst->data[pixel_idx + 3] = src->data[pixel_idx + 3];
         }
     }
+    free_palette_lut(lut);
 
     printf("Quantized image colors using palette with %d colors\n", palette->count);
     return dst;
 }
 
 
+typedef struct {
+    uint32_t count;
+    uint64_t r_sum, g_sum, b_sum;
+    uint8_t key[3];  // histogram cell coordinates (r, g, b)
+} HistogramEntry;
+
+typedef struct {
+    int start;  // first entry of the box in the entry array
+    int length;
+    uint64_t count;
+    int split_axis;
+    int range;  // extent of the box along split_axis, in histogram cells
+} ColorBox;
+
+static int compare_axis_r(const void* a, const void* b) {
+    return ((const HistogramEntry*)a)->key[0] - ((const HistogramEntry*)b)->key[0];
+}
+
+static int compare_axis_g(const void* a, const void* b) {
+    return ((const HistogramEntry*)a)->key[1] - ((const HistogramEntry*)b)->key[1];
+}
+
+static int compare_axis_b(const void* a, const void* b) {
+    return ((const HistogramEntry*)a)->key[2] - ((const HistogramEntry*)b)->key[2];
+}
+
+static void measure_box(ColorBox* box, const HistogramEntry* entries) {
+    int lo[3] = {LUT_SIZE, LUT_SIZE, LUT_SIZE};
+    int hi[3] = {-1, -1, -1};
+    box->count = 0;
+
+    for (int i = box->start; i < box->start + box->length; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (entries[i].key[axis] < lo[axis]) lo[axis] = entries[i].key[axis];
+            if (entries[i].key[axis] > hi[axis]) hi[axis] = entries[i].key[axis];
+        }
+        box->count += entries[i].count;
+    }
+
+    box->split_axis = 0;
+    box->range = hi[0] - lo[0];
+    for (int axis = 1; axis < 3; axis++) {
+        if (hi[axis] - lo[axis] > box->range) {
+            box->range = hi[axis] - lo[axis];
+            box->split_axis = axis;
+        }
+    }
+}
+
+Palette* create_median_cut_palette(const Image* img, int max_colors) {
+    if (!img || !img->data || img->channels < 3 || max_colors <= 0) {
+        fprintf(stderr, "Error: invalid parameters for create_median_cut_palette\n");
+        return NULL;
+    }
+    if (max_colors > 256) max_colors = 256;
+
+    // Histogram over LUT_BITS per channel keeps the table small enough to
+    // stay in cache while the per-cell sums preserve full-precision averages
+    const int cells = LUT_SIZE * LUT_SIZE * LUT_SIZE;
+    HistogramEntry* histogram = calloc(cells, sizeof(HistogramEntry));
+    if (!histogram) {
+        fprintf(stderr, "Error: failed to allocate memory for color histogram\n");
+        return NULL;
+    }
+
+    for (int i = 0; i < img->width * img->height; i++) {
+        const uint8_t* px = img->data + i * img->channels;
+        HistogramEntry* entry = &histogram[lut_index(px[0], px[1], px[2])];
+        entry->count++;
+        entry->r_sum += px[0];
+        entry->g_sum += px[1];
+        entry->b_sum += px[2];
+    }
+
+    // Compact the occupied cells to the front so boxes are contiguous ranges
+    int used = 0;
+    for (int i = 0; i < cells; i++) {
+        if (histogram[i].count) {
+            histogram[used] = histogram[i];
+            histogram[used].key[0] = (uint8_t)(i >> (2 * LUT_BITS));
+            histogram[used].key[1] = (uint8_t)((i >> LUT_BITS) & (LUT_SIZE - 1));
+            histogram[used].key[2] = (uint8_t)(i & (LUT_SIZE - 1));
+            used++;
+        }
+    }
+
+    ColorBox* boxes = malloc(max_colors * sizeof(ColorBox));
+    Palette* palette = create_palette(max_colors);
+    if (!boxes || !palette) {
+        free(boxes);
+        free_palette(palette);
+        free(histogram);
+        return NULL;
+    }
+
+    int box_count = 0;
+    if (used > 0) {
+        boxes[0].start = 0;
+        boxes[0].length = used;
+        measure_box(&boxes[0], histogram);
+        box_count = 1;
+    }
+
+    while (box_count < max_colors) {
+        // Split the most populated box that still spans more than one cell
+        int target = -1;
+        for (int i = 0; i < box_count; i++) {
+            if (boxes[i].length > 1 && (target < 0 || boxes[i].count > boxes[target].count)) {
+                target = i;
+            }
+        }
+        if (target < 0) break;
+
+        ColorBox* box = &boxes[target];
+        static int (*const comparators[3])(const void*, const void*) = {
+            compare_axis_r, compare_axis_g, compare_axis_b
+        };
+        qsort(histogram + box->start, box->length, sizeof(HistogramEntry), comparators[box->split_axis]);
+
+        uint64_t half = box->count / 2;
+        uint64_t running = 0;
+        int split = 1;
+        for (int i = 0; i < box->length - 1; i++) {
+            running += histogram[box->start + i].count;
+            split = i + 1;
+            if (running >= half) break;
+        }
+
+        ColorBox* upper = &boxes[box_count++];
+        upper->start = box->start + split;
+        upper->length = box->length - split;
+        box->length = split;
+        measure_box(box, histogram);
+        measure_box(upper, histogram);
+    }
+
+    for (int i = 0; i < box_count; i++) {
+        uint64_t count = 0, r = 0, g = 0, b = 0;
+        for (int j = boxes[i].start; j < boxes[i].start + boxes[i].length; j++) {
+            count += histogram[j].count;
+            r += histogram[j].r_sum;
+            g += histogram[j].g_sum;
+            b += histogram[j].b_sum;
+        }
+        add_color_to_palette(palette,
+                             (uint8_t)((r + count / 2) / count),
+                             (uint8_t)((g + count / 2) / count),
+                             (uint8_t)((b + count / 2) / count));
+    }
+
+    free(boxes);
+    free(histogram);
+
+    printf("Generated median cut palette with %d colors\n", palette->count);
+    return palette;
+}
+
+#define OCTREE_DEPTH 8
+#define OCTREE_NONE -1
+
+typedef struct {
+    uint64_t r_sum, g_sum, b_sum;
+    uint32_t count;
+    int32_t children[8];
+    int32_t next;  // next node in the reducible list, or in the free list
+    uint8_t level;
+    uint8_t is_leaf;
+} OctreeNode;
+
+struct OctreeQuantizer {
+    OctreeNode* nodes;
+    int pool_size;
+    int free_list;
+    int free_count;
+    int root;
+    int leaf_count;
+    int max_colors;
+    int32_t reducible[OCTREE_DEPTH];  // internal nodes per level
+};
+
+static int octree_alloc_node(OctreeQuantizer* octree, int level) {
+    int index = octree->free_list;
+    OctreeNode* node = &octree->nodes[index];
+    octree->free_list = node->next;
+    octree->free_count--;
+
+    memset(node, 0, sizeof(OctreeNode));
+    for (int i = 0; i < 8; i++) {
+        node->children[i] = OCTREE_NONE;
+    }
+    node->level = (uint8_t)level;
+    node->is_leaf = level == OCTREE_DEPTH;
+    node->next = OCTREE_NONE;
+
+    if (node->is_leaf) {
+        octree->leaf_count++;
+    } else {
+        node->next = octree->reducible[level];
+        octree->reducible[level] = index;
+    }
+    return index;
+}
+
+static void octree_release_node(OctreeQuantizer* octree, int index) {
+    octree->nodes[index].next = octree->free_list;
+    octree->free_list = index;
+    octree->free_count++;
+}
+
+// Folds the children of the deepest internal node into it. Nodes on the
+// deepest reducible level only have leaf children, so this always shrinks
+// the leaf count and returns the children to the pool.
+static int octree_reduce(OctreeQuantizer* octree) {
+    int level = OCTREE_DEPTH - 1;
+    while (level >= 0 && octree->reducible[level] == OCTREE_NONE) {
+        level--;
+    }
+    if (level < 0) {
+        return 0;
+    }
+
+    int index = octree->reducible[level];
+    OctreeNode* node = &octree->nodes[index];
+    octree->reducible[level] = node->next;
+
+    int merged = 0;
+    for (int i = 0; i < 8; i++) {
+        int child_index = node->children[i];
+        if (child_index == OCTREE_NONE) continue;
+
+        OctreeNode* child = &octree->nodes[child_index];
+        node->r_sum += child->r_sum;
+        node->g_sum += child->g_sum;
+        node->b_sum += child->b_sum;
+        node->count += child->count;
+        node->children[i] = OCTREE_NONE;
+        octree_release_node(octree, child_index);
+        merged++;
+    }
+
+    node->is_leaf = 1;
+    node->next = OCTREE_NONE;
+    octree->leaf_count -= merged - 1;
+    return 1;
+}
+
+OctreeQuantizer* create_octree_quantizer(int max_colors, int pool_size) {
+    if (max_colors <= 0 || max_colors > 256) {
+        fprintf(stderr, "Error: octree quantizer supports between 1 and 256 colors\n");
+        return NULL;
+    }
+
+    // A single insertion creates at most OCTREE_DEPTH nodes below the root
+    if (pool_size < OCTREE_DEPTH + 1) {
+        pool_size = OCTREE_DEPTH + 1;
+    }
+
+    OctreeQuantizer* octree = malloc(sizeof(OctreeQuantizer));
+    if (!octree) {
+        fprintf(stderr, "Error: failed to allocate memory for octree quantizer\n");
+        return NULL;
+    }
+
+    octree->nodes = malloc(pool_size * sizeof(OctreeNode));
+    if (!octree->nodes) {
+        fprintf(stderr, "Error: failed to allocate memory for octree node pool\n");
+        free(octree);
+        return NULL;
+    }
+
+    octree->pool_size = pool_size;
+    octree->max_colors = max_colors;
+    octree->leaf_count = 0;
+    for (int i = 0; i < OCTREE_DEPTH; i++) {
+        octree->reducible[i] = OCTREE_NONE;
+    }
+    for (int i = 0; i < pool_size; i++) {
+        octree->nodes[i].next = i + 1 < pool_size ? i + 1 : OCTREE_NONE;
+    }
+    octree->free_list = 0;
+    octree->free_count = pool_size;
+    octree->root = octree_alloc_node(octree, 0);
+    return octree;
+}
+
+void free_octree_quantizer(OctreeQuantizer* octree) {
+    if (octree) {
+        free(octree->nodes);
+        free(octree);
+    }
+}
+
+void octree_add_color(OctreeQuantizer* octree, uint8_t r, uint8_t g, uint8_t b) {
+    // Make room up front so the descent below never runs out of nodes
+    while (octree->free_count < OCTREE_DEPTH || octree->leaf_count > octree->max_colors) {
+        if (!octree_reduce(octree)) break;
+    }
+
+    int index = octree->root;
+    while (!octree->nodes[index].is_leaf) {
+        int level = octree->nodes[index].level;
+        int shift = 7 - level;
+        int child = (((r >> shift) & 1) << 2) | (((g >> shift) & 1) << 1) | ((b >> shift) & 1);
+
+        if (octree->nodes[index].children[child] == OCTREE_NONE) {
+            int created = octree_alloc_node(octree, level + 1);
+            octree->nodes[index].children[child] = created;
+        }
+        index = octree->nodes[index].children[child];
+    }
+
+    OctreeNode* leaf = &octree->nodes[index];
+    leaf->r_sum += r;
+    leaf->g_sum += g;
+    leaf->b_sum += b;
+    leaf->count++;
+}
+
+void octree_add_image(OctreeQuantizer* octree, const Image* img) {
+    if (!octree || !img || !img->data || img->channels < 3) {
+        return;
+    }
+
+    for (int i = 0; i < img->width * img->height; i++) {
+        const uint8_t* px = img->data + i * img->channels;
+        octree_add_color(octree, px[0], px[1], px[2]);
+    }
+}
+
+static void octree_collect_leaves(const OctreeQuantizer* octree, int index, Palette* palette) {
+    const OctreeNode* node = &octree->nodes[index];
+    if (node->is_leaf) {
+        if (node->count) {
+            add_color_to_palette(palette,
+                                 (uint8_t)((node->r_sum + node->count / 2) / node->count),
+                                 (uint8_t)((node->g_sum + node->count / 2) / node->count),
+                                 (uint8_t)((node->b_sum + node->count / 2) / node->count));
+        }
+        return;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        if (node->children[i] != OCTREE_NONE) {
+            octree_collect_leaves(octree, node->children[i], palette);
+        }
+    }
+}
+
+Palette* octree_build_palette(OctreeQuantizer* octree) {
+    if (!octree) {
+        return NULL;
+    }
+
+    while (octree->leaf_count > octree->max_colors) {
+        if (!octree_reduce(octree)) break;
+    }
+
+    Palette* palette = create_palette(octree->max_colors);
+    if (!palette) {
+        return NULL;
+    }
+
+    octree_collect_leaves(octree, octree->root, palette);
+    return palette;
+}
+
+Palette* create_octree_palette(const Image* img, int max_colors) {
+    if (!img || !img->data || img->channels < 3 || max_colors <= 0) {
+        fprintf(stderr, "Error: invalid parameters for create_octree_palette\n");
+        return NULL;
+    }
+    if (max_colors > 256) max_colors = 256;
+
+    OctreeQuantizer* octree = create_octree_quantizer(max_colors, OCTREE_DEFAULT_POOL_SIZE);
+    if (!octree) {
+        return NULL;
+    }
+
+    octree_add_image(octree, img);
+    Palette* palette = octree_build_palette(octree);
+    free_octree_quantizer(octree);
+
+    if (palette) {
+        printf("Generated octree palette with %d colors\n", palette->count);
+    }
+    return palette;
+}
+
+typedef struct {
+    uint64_t r, g, b;
+    uint64_t count;
+} ClusterSum;
+
+typedef struct {
+    const Image* img;
+    const PaletteLanes* lanes;
+    ClusterSum* sums;  // one block of lanes->count sums per worker
+} KMeansContext;
+
+// Assignment step: each worker accumulates into its own block of sums,
+// so no synchronization is needed until the blocks are merged
+static void kmeans_assign(void* context, int start, int end, int worker) {
+    KMeansContext* ctx = context;
+    const Image* img = ctx->img;
+    ClusterSum* sums = ctx->sums + (size_t)worker * ctx->lanes->count;
+
+    for (int i = start; i < end; i++) {
+        const uint8_t* px = img->data + (size_t)i * img->channels;
+        ClusterSum* sum = &sums[palette_lanes_nearest(ctx->lanes, px[0], px[1], px[2])];
+        sum->r += px[0];
+        sum->g += px[1];
+        sum->b += px[2];
+        sum->count++;
+    }
+}
+
+int refine_palette_kmeans(Palette* palette, const Image* img, int max_iterations, double threshold) {
+    if (!palette || palette->count == 0 || !img || !img->data || img->channels < 3) {
+        fprintf(stderr, "Error: invalid parameters for refine_palette_kmeans\n");
+        return -1;
+    }
+
+    int pixel_count = img->width * img->height;
+    int workers = parallel_worker_count(pixel_count);
+    ClusterSum* sums = malloc((size_t)workers * palette->count * sizeof(ClusterSum));
+    if (!sums) {
+        fprintf(stderr, "Error: failed to allocate memory for k-means cluster sums\n");
+        return -1;
+    }
+
+    int iteration = 0;
+    double movement = 0.0;
+
+    while (iteration < max_iterations) {
+        PaletteLanes* lanes = create_palette_lanes(palette);
+        if (!lanes) break;
+
+        KMeansContext ctx = {img, lanes, sums};
+        memset(sums, 0, (size_t)workers * palette->count * sizeof(ClusterSum));
+        parallel_for(pixel_count, workers, kmeans_assign, &ctx);
+        free_palette_lanes(lanes);
+        iteration++;
+
+        // Update step: merge the per-worker sums and move each centroid.
+        // Clusters that received no pixels keep their previous color.
+        movement = 0.0;
+        for (int i = 0; i < palette->count; i++) {
+            ClusterSum total = {0, 0, 0, 0};
+            for (int w = 0; w < workers; w++) {
+                const ClusterSum* part = &sums[(size_t)w * palette->count + i];
+                total.r += part->r;
+                total.g += part->g;
+                total.b += part->b;
+                total.count += part->count;
+            }
+            if (total.count == 0) continue;
+
+            Color updated = {
+                (uint8_t)((total.r + total.count / 2) / total.count),
+                (uint8_t)((total.g + total.count / 2) / total.count),
+                (uint8_t)((total.b + total.count / 2) / total.count)
+            };
+            double distance = color_distance(palette->colors[i].r, palette->colors[i].g, palette->colors[i].b,
+                                             updated.r, updated.g, updated.b);
+            if (distance > movement) movement = distance;
+            palette->colors[i] = updated;
+        }
+
+        if (movement <= threshold) break;
+    }
+
+    free(sums);
+
+    // The colors moved, so any lookup table built for the palette is stale
+    free_palette_lut(palette->lut);
+    palette->lut = NULL;
+
+    printf("Refined palette with k-means: %d iterations, final movement %.2f\n", iteration, movement);
+    return iteration;
+}
@@ -0,0 +1,534 @@
+#include "../include/pixel_art.h"
+#include <pthread.h>
+
+// Deflate encoder for the PNG writer. Matches are found with hash chains
+// whose depth grows with the compression level and are coded with the
+// fixed Huffman tables, the same trade-off stb_image_write makes.
+//
+// Input is cut into fixed-size chunks that are compressed concurrently.
+// Each chunk primes its dictionary with the 32 KB before it and ends on a
+// sync flush (an empty stored block), so the byte-aligned chunk outputs
+// concatenate into one valid stream. Chunk boundaries depend only on the
+// input length, so the output is the same for any thread count.
+
+#define WINDOW_SIZE 32768
+#define WINDOW_MASK (WINDOW_SIZE - 1)
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define MAX_STORED_BLOCK 65535
+#define DEFLATE_CHUNK_SIZE (256 * 1024)
+#define ADLER_BASE 65521
+
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+    uint64_t bits;
+    int bit_count;
+    int failed;
+} BitWriter;
+
+typedef struct {
+    int max_chain;    // hash chain entries examined per position
+    int nice_length;  // stop searching once a match is this long
+    int insert_all;   // index every position inside a match, not just its start
+} LevelSettings;
+
+static const LevelSettings level_settings[10] = {
+    {0, 0, 0},       // 0: stored blocks only
+    {4, 32, 0},
+    {8, 64, 0},
+    {16, 128, 0},
+    {32, 128, 1},
+    {64, 258, 1},
+    {128, 258, 1},
+    {256, 258, 1},
+    {512, 258, 1},
+    {1024, 258, 1}
+};
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static void writer_reserve(BitWriter* writer, size_t extra) {
+    if (writer->failed || writer->length + extra <= writer->capacity) {
+        return;
+    }
+
+    size_t capacity = writer->capacity ? writer->capacity : 4096;
+    while (capacity < writer->length + extra) {
+        capacity *= 2;
+    }
+    uint8_t* data = realloc(writer->data, capacity);
+    if (!data) {
+        writer->failed = 1;
+        return;
+    }
+    writer->data = data;
+    writer->capacity = capacity;
+}
+
+// Bits are emitted least significant first, as deflate requires
+static inline void put_bits(BitWriter* writer, uint32_t value, int count) {
+    writer->bits |= (uint64_t)value << writer->bit_count;
+    writer->bit_count += count;
+    if (writer->bit_count >= 32) {
+        writer_reserve(writer, 4);
+        if (!writer->failed) {
+            for (int i = 0; i < 4; i++) {
+                writer->data[writer->length++] = (uint8_t)(writer->bits >> (8 * i));
+            }
+        }
+        writer->bits >>= 32;
+        writer->bit_count -= 32;
+    }
+}
+
+static void align_to_byte(BitWriter* writer) {
+    writer_reserve(writer, 8);
+    while (writer->bit_count > 0 && !writer->failed) {
+        writer->data[writer->length++] = (uint8_t)writer->bits;
+        writer->bits >>= 8;
+        writer->bit_count = writer->bit_count > 8 ? writer->bit_count - 8 : 0;
+    }
+    writer->bits = 0;
+    writer->bit_count = 0;
+}
+
+static void put_bytes(BitWriter* writer, const uint8_t* data, size_t length) {
+    writer_reserve(writer, length);
+    if (!writer->failed && length > 0) {
+        memcpy(writer->data + writer->length, data, length);
+        writer->length += length;
+    }
+}
+
+// Fixed Huffman codes, bit-reversed for put_bits, plus symbol lookups for
+// match lengths and distances. Built once and shared by all threads.
+static uint16_t literal_codes[288];
+static uint8_t literal_lengths[288];
+static uint8_t length_symbol[MAX_MATCH + 1];
+static uint8_t distance_symbol[512];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static uint32_t reverse_bits(uint32_t code, int length) {
+    uint32_t result = 0;
+    for (int i = 0; i < length; i++) {
+        result = (result << 1) | ((code >> i) & 1);
+    }
+    return result;
+}
+
+static void build_tables(void) {
+    for (int symbol = 0; symbol < 288; symbol++) {
+        uint32_t code;
+        int length;
+        if (symbol < 144) {
+            code = 0x30 + symbol;
+            length = 8;
+        } else if (symbol < 256) {
+            code = 0x190 + symbol - 144;
+            length = 9;
+        } else if (symbol < 280) {
+            code = symbol - 256;
+            length = 7;
+        } else {
+            code = 0xC0 + symbol - 280;
+            length = 8;
+        }
+        literal_codes[symbol] = (uint16_t)reverse_bits(code, length);
+        literal_lengths[symbol] = (uint8_t)length;
+    }
+
+    for (int code = 0; code < 29; code++) {
+        int last = code == 28 ? MAX_MATCH : length_base[code + 1] - 1;
+        for (int length = length_base[code]; length <= last; length++) {
+            length_symbol[length] = (uint8_t)code;
+        }
+    }
+
+    // Distances up to 256 index directly; larger ones by (distance - 1) >> 7
+    for (int code = 0; code < 30; code++) {
+        int last = code == 29 ? WINDOW_SIZE : distance_base[code + 1] - 1;
+        for (int distance = distance_base[code]; distance <= last; distance++) {
+            if (distance <= 256) {
+                distance_symbol[distance - 1] = (uint8_t)code;
+            } else {
+                distance_symbol[256 + ((distance - 1) >> 7)] = (uint8_t)code;
+            }
+        }
+    }
+}
+
+static inline void put_literal_code(BitWriter* writer, int symbol) {
+    put_bits(writer, literal_codes[symbol], literal_lengths[symbol]);
+}
+
+static void put_match(BitWriter* writer, int length, int distance) {
+    int code = length_symbol[length];
+    put_literal_code(writer, 257 + code);
+    if (length_extra[code]) {
+        put_bits(writer, length - length_base[code], length_extra[code]);
+    }
+
+    code = distance <= 256 ? distance_symbol[distance - 1] : distance_symbol[256 + ((distance - 1) >> 7)];
+    put_bits(writer, reverse_bits(code, 5), 5);
+    if (distance_extra[code]) {
+        put_bits(writer, distance - distance_base[code], distance_extra[code]);
+    }
+}
+
+static inline uint32_t hash3(const uint8_t* p) {
+    uint32_t value = (uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2];
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static void write_stored_blocks(BitWriter* writer, const uint8_t* data, size_t start, size_t end, int final) {
+    do {
+        size_t length = end - start > MAX_STORED_BLOCK ? MAX_STORED_BLOCK : end - start;
+        int last = final && start + length == end;
+        put_bits(writer, last, 3);  // BTYPE 00
+        align_to_byte(writer);
+
+        uint8_t header[4] = {
+            (uint8_t)length, (uint8_t)(length >> 8),
+            (uint8_t)~length, (uint8_t)(~length >> 8)
+        };
+        put_bytes(writer, header, 4);
+        put_bytes(writer, data + start, length);
+        start += length;
+    } while (start < end);
+}
+
+// Compresses data[start, end) as one fixed Huffman block. Matches may
+// reach back before start, which lets independently compressed segments
+// still use the preceding 32 KB as their dictionary.
+static void write_fixed_block(BitWriter* writer, const uint8_t* data, size_t start, size_t end,
+                              const LevelSettings* settings, int final) {
+    int32_t* head = malloc(HASH_SIZE * sizeof(int32_t));
+    int32_t* prev = malloc(WINDOW_SIZE * sizeof(int32_t));
+    if (!head || !prev) {
+        free(head);
+        free(prev);
+        writer->failed = 1;
+        return;
+    }
+    memset(head, 0xFF, HASH_SIZE * sizeof(int32_t));
+
+    size_t dictionary_start = start > WINDOW_SIZE ? start - WINDOW_SIZE : 0;
+    for (size_t i = dictionary_start; i < start && i + MIN_MATCH <= end; i++) {
+        uint32_t h = hash3(data + i);
+        prev[i & WINDOW_MASK] = head[h];
+        head[h] = (int32_t)i;
+    }
+
+    put_bits(writer, final | (1 << 1), 3);  // BTYPE 01: fixed Huffman
+
+    size_t i = start;
+    while (i < end) {
+        int best_length = 0;
+        int best_distance = 0;
+
+        if (i + MIN_MATCH <= end) {
+            uint32_t h = hash3(data + i);
+            int32_t candidate = head[h];
+            int max_length = end - i < MAX_MATCH ? (int)(end - i) : MAX_MATCH;
+            int chain = settings->max_chain;
+
+            while (candidate >= 0 && i - (size_t)candidate <= WINDOW_SIZE && chain-- > 0) {
+                const uint8_t* a = data + candidate;
+                const uint8_t* b = data + i;
+                if (a[best_length] == b[best_length]) {
+                    int length = 0;
+                    while (length < max_length && a[length] == b[length]) {
+                        length++;
+                    }
+                    if (length > best_length) {
+                        best_length = length;
+                        best_distance = (int)(i - candidate);
+                        if (length >= settings->nice_length || length == max_length) break;
+                    }
+                }
+                int32_t next = prev[candidate & WINDOW_MASK];
+                if (next >= candidate) break;
+                candidate = next;
+            }
+
+            prev[i & WINDOW_MASK] = head[h];
+            head[h] = (int32_t)i;
+        }
+
+        if (best_length >= MIN_MATCH) {
+            put_match(writer, best_length, best_distance);
+            if (settings->insert_all) {
+                for (size_t j = i + 1; j < i + best_length && j + MIN_MATCH <= end; j++) {
+                    uint32_t h = hash3(data + j);
+                    prev[j & WINDOW_MASK] = head[h];
+                    head[h] = (int32_t)j;
+                }
+            }
+            i += best_length;
+        } else {
+            put_literal_code(writer, data[i]);
+            i++;
+        }
+    }
+
+    put_literal_code(writer, 256);
+    free(head);
+    free(prev);
+}
+
+static void write_segment(BitWriter* writer, const uint8_t* data, size_t start, size_t end, int level, int final) {
+    pthread_once(&tables_once, build_tables);
+    if (level <= 0 || start == end) {
+        write_stored_blocks(writer, data, start, end, final);
+    } else {
+        write_fixed_block(writer, data, start, end, &level_settings[level > 9 ? 9 : level], final);
+    }
+}
+
+// Ends a non-final chunk on a byte boundary with an empty stored block
+static void write_sync_flush(BitWriter* writer) {
+    static const uint8_t empty_block[4] = {0x00, 0x00, 0xFF, 0xFF};
+    put_bits(writer, 0, 3);
+    align_to_byte(writer);
+    put_bytes(writer, empty_block, 4);
+}
+
+uint32_t adler32_update(uint32_t adler, const uint8_t* data, size_t length) {
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (length > 0) {
+        // 5552 is the most bytes that can be summed before b may overflow
+        size_t block = length < 5552 ? length : 5552;
+        length -= block;
+        while (block--) {
+            a += *data++;
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+    return b << 16 | a;
+}
+
+// Checksum of A followed by B, given the checksums of both and B's length
+static uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, size_t length2) {
+    uint64_t remainder = length2 % ADLER_BASE;
+    uint64_t a1 = adler1 & 0xFFFF;
+    uint64_t b1 = adler1 >> 16;
+    uint64_t a2 = adler2 & 0xFFFF;
+    uint64_t b2 = adler2 >> 16;
+
+    uint64_t a = (a1 + a2 + ADLER_BASE - 1) % ADLER_BASE;
+    uint64_t b = (remainder * a1 + b1 + b2 + ADLER_BASE - remainder) % ADLER_BASE;
+    return (uint32_t)(b << 16 | a);
+}
+
+typedef struct {
+    const uint8_t* data;
+    size_t start;  // bytes before start only serve as dictionary
+    size_t end;
+    int level;
+    int final;
+    int chunk_count;
+    BitWriter* writers;
+    uint32_t* adlers;
+} DeflateContext;
+
+static void compress_chunks(void* context, int start, int end, int worker) {
+    (void)worker;
+    DeflateContext* ctx = context;
+    for (int chunk = start; chunk < end; chunk++) {
+        size_t chunk_start = ctx->start + (size_t)chunk * DEFLATE_CHUNK_SIZE;
+        size_t chunk_end = chunk_start + DEFLATE_CHUNK_SIZE < ctx->end ? chunk_start + DEFLATE_CHUNK_SIZE : ctx->end;
+        int final = ctx->final && chunk == ctx->chunk_count - 1;
+
+        BitWriter* writer = &ctx->writers[chunk];
+        writer_reserve(writer, (chunk_end - chunk_start) / 4 + 64);
+        write_segment(writer, ctx->data, chunk_start, chunk_end, ctx->level, final);
+        if (final) {
+            align_to_byte(writer);
+        } else {
+            write_sync_flush(writer);
+        }
+        ctx->adlers[chunk] = adler32_update(1, ctx->data + chunk_start, chunk_end - chunk_start);
+    }
+}
+
+// Compresses data[start, end) in parallel chunks and appends the deflate
+// blocks to output, folding the range into *adler. A non-final range ends
+// byte aligned so more blocks can follow.
+static int compress_range(BitWriter* output, const uint8_t* data, size_t start, size_t end, int level,
+                          int final, uint32_t* adler) {
+    size_t length = end - start;
+    int chunk_count = (int)((length + DEFLATE_CHUNK_SIZE - 1) / DEFLATE_CHUNK_SIZE);
+    if (chunk_count == 0) {
+        if (!final) {
+            return 1;
+        }
+        chunk_count = 1;  // an empty final block still closes the stream
+    }
+
+    BitWriter* writers = calloc(chunk_count, sizeof(BitWriter));
+    uint32_t* adlers = malloc(chunk_count * sizeof(uint32_t));
+    if (!writers || !adlers) {
+        free(writers);
+        free(adlers);
+        return 0;
+    }
+
+    DeflateContext ctx = {data, start, end, level, final, chunk_count, writers, adlers};
+    parallel_for(chunk_count, 0, compress_chunks, &ctx);
+
+    size_t total = 0;
+    int failed = 0;
+    for (int i = 0; i < chunk_count; i++) {
+        total += writers[i].length;
+        failed |= writers[i].failed;
+    }
+
+    if (!failed) {
+        writer_reserve(output, total);
+        for (int i = 0; i < chunk_count; i++) {
+            put_bytes(output, writers[i].data, writers[i].length);
+            size_t chunk_length = i == chunk_count - 1 ? length - (size_t)i * DEFLATE_CHUNK_SIZE : DEFLATE_CHUNK_SIZE;
+            *adler = adler32_combine(*adler, adlers[i], chunk_length);
+        }
+    }
+
+    for (int i = 0; i < chunk_count; i++) {
+        free(writers[i].data);
+    }
+    free(writers);
+    free(adlers);
+    return !failed && !output->failed;
+}
+
+// CMF: deflate with a 32 KB window; FLG: check bits for the header
+static const uint8_t zlib_header[2] = {0x78, 0x01};
+
+static void put_adler_trailer(BitWriter* output, uint32_t adler) {
+    uint8_t trailer[4] = {(uint8_t)(adler >> 24), (uint8_t)(adler >> 16), (uint8_t)(adler >> 8), (uint8_t)adler};
+    put_bytes(output, trailer, 4);
+}
+
+uint8_t* zlib_compress(const uint8_t* data, size_t length, int level, size_t* out_length) {
+    BitWriter output = {0};
+    uint32_t adler = 1;
+
+    writer_reserve(&output, length / 4 + 64);
+    put_bytes(&output, zlib_header, sizeof(zlib_header));
+    int ok = compress_range(&output, data, 0, length, level, 1, &adler);
+    put_adler_trailer(&output, adler);
+
+    if (!ok || output.failed) {
+        fprintf(stderr, "Error: failed to allocate memory for compressed data\n");
+        free(output.data);
+        return NULL;
+    }
+
+    *out_length = output.length;
+    return output.data;
+}
+
+// zlib stream fed in pieces. The last WINDOW_SIZE bytes written are kept so
+// matches can reach back across calls; each call's output ends byte
+// aligned and can be written out immediately.
+struct DeflateStream {
+    int level;
+    int started;
+    int finished;
+    uint32_t adler;
+    uint8_t* buffer;  // history followed by the data of the current call
+    size_t history;
+    size_t capacity;
+};
+
+DeflateStream* create_deflate_stream(int level) {
+    DeflateStream* stream = calloc(1, sizeof(DeflateStream));
+    if (!stream) {
+        fprintf(stderr, "Error: failed to allocate memory for deflate stream\n");
+        return NULL;
+    }
+    stream->level = level;
+    stream->adler = 1;
+    return stream;
+}
+
+// Compresses the next length bytes and returns the bytes to append to the
+// stream (possibly none); final closes the stream and adds the checksum
+uint8_t* deflate_stream_write(DeflateStream* stream, const uint8_t* data, size_t length, int final,
+                              size_t* out_length) {
+    if (stream->finished) {
+        fprintf(stderr, "Error: deflate stream is already finished\n");
+        return NULL;
+    }
+
+    size_t total = stream->history + length;
+    if (total > stream->capacity) {
+        uint8_t* buffer = realloc(stream->buffer, total);
+        if (!buffer) {
+            fprintf(stderr, "Error: failed to allocate memory for compressed data\n");
+            return NULL;
+        }
+        stream->buffer = buffer;
+        stream->capacity = total;
+    }
+    if (length > 0) {
+        memcpy(stream->buffer + stream->history, data, length);
+    }
+
+    BitWriter output = {0};
+    writer_reserve(&output, length / 4 + 64);
+    if (!stream->started) {
+        put_bytes(&output, zlib_header, sizeof(zlib_header));
+        stream->started = 1;
+    }
+    int ok = compress_range(&output, stream->buffer, stream->history, total, stream->level, final, &stream->adler);
+    if (final) {
+        put_adler_trailer(&output, stream->adler);
+        stream->finished = 1;
+    }
+
+    if (!ok || output.failed) {
+        fprintf(stderr, "Error: failed to allocate memory for compressed data\n");
+        free(output.data);
+        return NULL;
+    }
+
+    // Keep the most recent window as the next call's dictionary
+    size_t keep = total < WINDOW_SIZE ? total : WINDOW_SIZE;
+    if (keep > 0) {
+        memmove(stream->buffer, stream->buffer + total - keep, keep);
+    }
+    stream->history = keep;
+
+    *out_length = output.length;
+    return output.data;
+}
+
+void free_deflate_stream(DeflateStream* stream) {
+    if (!stream) {
+        return;
+    }
+    free(stream->buffer);
+    free(stream);
+}
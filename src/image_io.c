@@ -6,6 +6,47 @@
 
 #include "../include/pixel_art.h"
 #include <ctype.h>
+#include <limits.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HAVE_MMAP 1
+#endif
+
+#ifdef HAVE_MMAP
+// Decodes straight from a read-only mapping of the file, so the encoded
+// bytes come from the page cache without a copy through stdio buffers.
+// Sets *mapped to 0 when the file could not be mapped, in which case the
+// caller falls back to stbi_load.
+static unsigned char* load_mapped(const char* filename, int* width, int* height, int* channels, int* mapped) {
+    *mapped = 0;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 || st.st_size > INT_MAX) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    *mapped = 1;
+    unsigned char* data = stbi_load_from_memory(map, (int)size, width, height, channels, 0);
+    munmap(map, size);
+    return data;
+}
+#endif
 
 Image* load_image(const char* filename) {
     if (!filename) {
@@ -19,7 +60,13 @@ Image* load_image(const char* filename) {
         return NULL;
     }
 
-    img->data = stbi_load(filename, &img->width, &img->height, &img->channels, 0);
+    int mapped = 0;
+#ifdef HAVE_MMAP
+    img->data = load_mapped(filename, &img->width, &img->height, &img->channels, &mapped);
+#endif
+    if (!mapped) {
+        img->data = stbi_load(filename, &img->width, &img->height, &img->channels, 0);
+    }
 
     if (!img->data) {
         fprintf(stderr, "Error: failed to load image '%s': %s\n", filename, stbi_failure_reason());
@@ -53,7 +100,7 @@ int save_image(const char* filename, const Image* img) {
     }
 
     if (strcmp(ext_lower, "png") == 0) {
-        result = stbi_write_png(filename, img->width, img->height, img->channels, img->data, img->width * img->channels);
+        result = write_png(filename, img, 0);
     } else if (strcmp(ext_lower, "bmp") == 0) {
         result = stbi_write_bmp(filename, img->width, img->height, img->channels, img->data);
     } else if (strcmp(ext_lower, "tga") == 0) {
@@ -74,6 +121,28 @@ int save_image(const char* filename, const Image* img) {
     return result;
 }
 
+int save_image_with_scale(const char* filename, const Image* img, int scale) {
+    if (!filename || !img || !img->data || scale <= 0) {
+        fprintf(stderr, "Error: invalid parameters for save_image_with_scale\n");
+        return 0;
+    }
+
+    const char* ext = strrchr(filename, '.');
+    if (!ext || (strcmp(ext, ".png") != 0 && strcmp(ext, ".PNG") != 0)) {
+        // Only PNG can carry the scale; other formats are saved as-is
+        return save_image(filename, img);
+    }
+
+    int result = write_png(filename, img, scale);
+    if (result) {
+        printf("Saved image: %s (%dx%d, %d channels, display scale %d)\n",
+               filename, img->width, img->height, img->channels, scale);
+    } else {
+        fprintf(stderr, "Error: failed to save image '%s'\n", filename);
+    }
+    return result;
+}
+
 void free_image(Image* img) {
     if (img) {
         if (img->data) {
@@ -83,6 +152,156 @@ void free_image(Image* img) {
     }
 }
 
+IndexedImage* create_indexed_image(int width, int height, const Palette* palette, int has_alpha) {
+    if (width <= 0 || height <= 0 || !palette) {
+        fprintf(stderr, "Error: invalid parameters for create_indexed_image\n");
+        return NULL;
+    }
+
+    IndexedImage* img = calloc(1, sizeof(IndexedImage));
+    if (!img) {
+        fprintf(stderr, "Error: failed to allocate memory for indexed image\n");
+        return NULL;
+    }
+
+    img->width = width;
+    img->height = height;
+    img->indices = malloc((size_t)width * height);
+    img->alpha = has_alpha ? malloc((size_t)width * height) : NULL;
+    img->palette = create_palette(palette->count > 0 ? palette->count : 1);
+
+    if (!img->indices || (has_alpha && !img->alpha) || !img->palette) {
+        fprintf(stderr, "Error: failed to allocate memory for indexed image data\n");
+        free_indexed_image(img);
+        return NULL;
+    }
+
+    for (int i = 0; i < palette->count; i++) {
+        add_color_to_palette(img->palette, palette->colors[i].r, palette->colors[i].g, palette->colors[i].b);
+    }
+    return img;
+}
+
+void free_indexed_image(IndexedImage* img) {
+    if (img) {
+        free(img->indices);
+        free(img->alpha);
+        free_palette(img->palette);
+        free(img);
+    }
+}
+
+Image* indexed_to_image(const IndexedImage* img) {
+    if (!img || !img->indices || !img->palette) {
+        fprintf(stderr, "Error: invalid parameters for indexed_to_image\n");
+        return NULL;
+    }
+
+    Image* dst = malloc(sizeof(Image));
+    if (!dst) {
+        fprintf(stderr, "Error: failed to allocate memory for image\n");
+        return NULL;
+    }
+
+    dst->width = img->width;
+    dst->height = img->height;
+    dst->channels = img->alpha ? 4 : 3;
+    dst->data = malloc((size_t)img->width * img->height * dst->channels);
+    if (!dst->data) {
+        fprintf(stderr, "Error: failed to allocate memory for image data\n");
+        free(dst);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < (size_t)img->width * img->height; i++) {
+        const Color* color = &img->palette->colors[img->indices[i]];
+        uint8_t* out = dst->data + i * dst->channels;
+        out[0] = color->r;
+        out[1] = color->g;
+        out[2] = color->b;
+        if (img->alpha) {
+            out[3] = img->alpha[i];
+        }
+    }
+    return dst;
+}
+
+// Indexed PNG needs one palette entry per (color, alpha) pair. Opaque
+// images map straight through; translucent ones are remapped when the
+// pairs still fit in 256 entries.
+static int save_indexed_png(const char* filename, const IndexedImage* img, int scale) {
+    const Palette* palette = img->palette;
+    if (!img->alpha) {
+        return write_indexed_png(filename, img->indices, img->width, img->height,
+                                 palette->colors, NULL, palette->count, scale);
+    }
+
+    size_t pixel_count = (size_t)img->width * img->height;
+    int16_t* pair_index = malloc(256 * 256 * sizeof(int16_t));
+    uint8_t* indices = malloc(pixel_count);
+    if (!pair_index || !indices) {
+        free(pair_index);
+        free(indices);
+        return -1;
+    }
+    memset(pair_index, 0xFF, 256 * 256 * sizeof(int16_t));
+
+    Color colors[256];
+    uint8_t alpha[256];
+    int count = 0;
+    for (size_t i = 0; i < pixel_count; i++) {
+        int pair = img->indices[i] << 8 | img->alpha[i];
+        if (pair_index[pair] < 0) {
+            if (count == 256) {
+                free(pair_index);
+                free(indices);
+                return -1;
+            }
+            colors[count] = palette->colors[img->indices[i]];
+            alpha[count] = img->alpha[i];
+            pair_index[pair] = (int16_t)count++;
+        }
+        indices[i] = (uint8_t)pair_index[pair];
+    }
+
+    int result = write_indexed_png(filename, indices, img->width, img->height, colors, alpha, count, scale);
+    free(pair_index);
+    free(indices);
+    return result;
+}
+
+int save_indexed_image(const char* filename, const IndexedImage* img, int scale) {
+    if (!filename || !img || !img->indices || !img->palette) {
+        fprintf(stderr, "Error: invalid parameters for save_indexed_image\n");
+        return 0;
+    }
+
+    const char* ext = strrchr(filename, '.');
+    int result = -1;
+    if (ext && (strcmp(ext, ".png") == 0 || strcmp(ext, ".PNG") == 0)) {
+        result = save_indexed_png(filename, img, scale);
+    }
+
+    if (result < 0) {
+        // Other formats, or too many color/alpha pairs: expand to RGB(A)
+        Image* expanded = indexed_to_image(img);
+        if (!expanded) {
+            return 0;
+        }
+        result = scale > 0 ? save_image_with_scale(filename, expanded, scale) : save_image(filename, expanded);
+        free_image(expanded);
+        return result;
+    }
+
+    if (result) {
+        printf("Saved indexed image: %s (%dx%d, %d colors)\n",
+               filename, img->width, img->height, img->palette->count);
+    } else {
+        fprintf(stderr, "Error: failed to save image '%s'\n", filename);
+    }
+    return result;
+}
+
 void print_image_info(const Image* img) {
     if (!img) {
         printf("Image: NULL\n");
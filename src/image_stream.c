@@ -0,0 +1,401 @@
+#include "../include/pixel_art.h"
+#include <limits.h>
+
+// Row-at-a-time decoders for images too large to load whole. PNG (except
+// interlaced files) and 8-bit binary PPM/PGM are supported. Rows come out in the
+// same channel layout and 8-bit sample values stbi_load would produce, so
+// streamed and in-memory conversions of one file agree.
+
+#define PNG_CHUNK_HEADER_SIZE 8
+
+typedef enum {
+    STREAM_PNG,
+    STREAM_PNM
+} StreamFormat;
+
+struct ImageReaderState {
+    StreamFormat format;
+    FILE* file;
+    int failed;
+
+    // PNG
+    int bit_depth;
+    int color_type;
+    int samples;                   // samples per pixel in the file
+    size_t row_bytes;              // packed bytes per row, without the filter byte
+    int filter_bpp;                // bytes per complete pixel, at least 1
+    uint8_t* current;              // filter byte + row being decoded
+    uint8_t* prior;                // previous unfiltered row
+    uint8_t palette[256 * 4];
+    int palette_count;
+    int has_transparency;          // tRNS present
+    uint16_t transparent[3];       // gray or RGB key for non-palette images
+    uint32_t idat_remaining;       // bytes left in the current IDAT chunk
+    int idat_done;
+    Inflater* inflater;
+};
+
+static uint32_t read_be32(const uint8_t* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// Feeds the inflater the contents of consecutive IDAT chunks
+static size_t read_idat(void* context, uint8_t* buffer, size_t capacity) {
+    ImageReaderState* state = context;
+    size_t total = 0;
+
+    while (total < capacity && !state->idat_done) {
+        if (state->idat_remaining == 0) {
+            uint8_t header[4 + PNG_CHUNK_HEADER_SIZE];
+            // CRC of the finished chunk, then the next chunk's length and type
+            if (fread(header, 1, sizeof(header), state->file) != sizeof(header) ||
+                memcmp(header + 8, "IDAT", 4) != 0) {
+                state->idat_done = 1;
+                break;
+            }
+            state->idat_remaining = read_be32(header + 4);
+            continue;
+        }
+
+        size_t wanted = capacity - total < state->idat_remaining ? capacity - total : state->idat_remaining;
+        size_t got = fread(buffer + total, 1, wanted, state->file);
+        total += got;
+        state->idat_remaining -= (uint32_t)got;
+        if (got < wanted) {
+            state->idat_done = 1;
+        }
+    }
+    return total;
+}
+
+static int open_png(ImageReader* reader, ImageReaderState* state) {
+    uint8_t ihdr[13];
+    uint8_t header[PNG_CHUNK_HEADER_SIZE];
+    int have_header = 0;
+
+    for (;;) {
+        if (fread(header, 1, PNG_CHUNK_HEADER_SIZE, state->file) != PNG_CHUNK_HEADER_SIZE) {
+            return 0;
+        }
+        uint32_t length = read_be32(header);
+        const uint8_t* type = header + 4;
+
+        if (memcmp(type, "IHDR", 4) == 0) {
+            if (length != 13 || fread(ihdr, 1, 13, state->file) != 13) {
+                return 0;
+            }
+            have_header = 1;
+        } else if (memcmp(type, "PLTE", 4) == 0) {
+            if (length > 256 * 3 || length % 3 != 0) {
+                return 0;
+            }
+            uint8_t entries[256 * 3];
+            if (fread(entries, 1, length, state->file) != length) {
+                return 0;
+            }
+            state->palette_count = (int)(length / 3);
+            for (int i = 0; i < state->palette_count; i++) {
+                memcpy(state->palette + i * 4, entries + i * 3, 3);
+                state->palette[i * 4 + 3] = 255;
+            }
+        } else if (memcmp(type, "tRNS", 4) == 0) {
+            uint8_t data[256];
+            if (length > sizeof(data) || fread(data, 1, length, state->file) != length || !have_header) {
+                return 0;
+            }
+            state->has_transparency = 1;
+            if (ihdr[9] == 3) {
+                for (uint32_t i = 0; i < length; i++) {
+                    state->palette[i * 4 + 3] = data[i];
+                }
+            } else {
+                for (uint32_t i = 0; i < 3 && i * 2 + 1 < length; i++) {
+                    state->transparent[i] = (uint16_t)(data[i * 2] << 8 | data[i * 2 + 1]);
+                }
+            }
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            state->idat_remaining = length;
+            break;
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            return 0;
+        } else if (fseek(state->file, length, SEEK_CUR) != 0) {
+            return 0;
+        }
+
+        if (memcmp(type, "IDAT", 4) != 0 && fseek(state->file, 4, SEEK_CUR) != 0) {  // CRC
+            return 0;
+        }
+    }
+
+    if (!have_header) {
+        return 0;
+    }
+
+    reader->width = (int)read_be32(ihdr);
+    reader->height = (int)read_be32(ihdr + 4);
+    state->bit_depth = ihdr[8];
+    state->color_type = ihdr[9];
+
+    // Interlaced rows arrive in seven passes, so they cannot be streamed
+    if (reader->width <= 0 || reader->height <= 0 || ihdr[10] != 0 || ihdr[11] != 0 || ihdr[12] != 0) {
+        return 0;
+    }
+
+    int depth = state->bit_depth;
+    switch (state->color_type) {
+        case 0: state->samples = 1; break;
+        case 2: state->samples = 3; break;
+        case 3: state->samples = 1; break;
+        case 4: state->samples = 2; break;
+        case 6: state->samples = 4; break;
+        default: return 0;
+    }
+    int valid_depth = depth == 8 || (depth == 16 && state->color_type != 3) ||
+                      ((depth == 1 || depth == 2 || depth == 4) && (state->color_type == 0 || state->color_type == 3));
+    if (!valid_depth || (state->color_type == 3 && state->palette_count == 0)) {
+        return 0;
+    }
+
+    // Same output layout as stbi_load: palettes expand to RGB(A) and a
+    // tRNS color key adds an alpha channel
+    if (state->color_type == 3) {
+        reader->channels = state->has_transparency ? 4 : 3;
+    } else {
+        reader->channels = state->samples + (state->has_transparency && (state->samples == 1 || state->samples == 3));
+    }
+
+    state->row_bytes = ((size_t)reader->width * state->samples * depth + 7) / 8;
+    state->filter_bpp = (state->samples * depth + 7) / 8;
+    state->current = malloc(state->row_bytes + 1);
+    state->prior = calloc(state->row_bytes, 1);
+    state->inflater = create_inflater(read_idat, state);
+    return state->current && state->prior && state->inflater;
+}
+
+static inline uint8_t paeth_predictor(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return (uint8_t)a;
+    if (pb <= pc) return (uint8_t)b;
+    return (uint8_t)c;
+}
+
+// Reverses the row filter in place; prior holds the previous unfiltered row
+static int unfilter_row(uint8_t filter, uint8_t* row, const uint8_t* prior, size_t length, int bpp) {
+    switch (filter) {
+        case 0:
+            break;
+        case 1:
+            for (size_t i = bpp; i < length; i++) row[i] = (uint8_t)(row[i] + row[i - bpp]);
+            break;
+        case 2:
+            for (size_t i = 0; i < length; i++) row[i] = (uint8_t)(row[i] + prior[i]);
+            break;
+        case 3:
+            for (size_t i = 0; i < length; i++) {
+                int left = i >= (size_t)bpp ? row[i - bpp] : 0;
+                row[i] = (uint8_t)(row[i] + ((left + prior[i]) >> 1));
+            }
+            break;
+        case 4:
+            for (size_t i = 0; i < length; i++) {
+                int left = i >= (size_t)bpp ? row[i - bpp] : 0;
+                int up_left = i >= (size_t)bpp ? prior[i - bpp] : 0;
+                row[i] = (uint8_t)(row[i] + paeth_predictor(left, prior[i], up_left));
+            }
+            break;
+        default:
+            return 0;
+    }
+    return 1;
+}
+
+// Converts one unfiltered PNG row to 8-bit samples in the reader's layout
+static void expand_png_row(const ImageReader* reader, const ImageReaderState* state, const uint8_t* row, uint8_t* out) {
+    int width = reader->width;
+    int depth = state->bit_depth;
+    int channels = reader->channels;
+
+    if (state->color_type == 3) {
+        for (int x = 0; x < width; x++) {
+            int index = depth == 8 ? row[x] : (row[x * depth / 8] >> (8 - depth - (x * depth) % 8)) & ((1 << depth) - 1);
+            memcpy(out + x * channels, state->palette + index * 4, channels);
+        }
+        return;
+    }
+
+    int samples = state->samples;
+    int keyed = channels > samples;
+    for (int x = 0; x < width; x++) {
+        uint8_t* px = out + x * channels;
+        int opaque = 0;
+        for (int c = 0; c < samples; c++) {
+            int value;
+            uint8_t sample;
+            if (depth == 16) {
+                value = row[(x * samples + c) * 2] << 8 | row[(x * samples + c) * 2 + 1];
+                sample = (uint8_t)(value >> 8);
+            } else if (depth == 8) {
+                value = row[x * samples + c];
+                sample = (uint8_t)value;
+            } else {
+                // Low bit depth gray, scaled to the full 0-255 range
+                static const uint8_t scale[5] = {0, 0xFF, 0x55, 0, 0x11};
+                value = (row[x * depth / 8] >> (8 - depth - (x * depth) % 8)) & ((1 << depth) - 1);
+                sample = (uint8_t)(value * scale[depth]);
+            }
+            px[c] = sample;
+            if (keyed && value != state->transparent[c]) {
+                opaque = 1;
+            }
+        }
+        if (keyed) {
+            px[samples] = opaque ? 255 : 0;
+        }
+    }
+}
+
+static int read_png_row(ImageReader* reader, ImageReaderState* state, uint8_t* out) {
+    size_t length = state->row_bytes + 1;
+    if (inflate_read(state->inflater, state->current, length) != length ||
+        !unfilter_row(state->current[0], state->current + 1, state->prior, state->row_bytes, state->filter_bpp)) {
+        return 0;
+    }
+
+    expand_png_row(reader, state, state->current + 1, out);
+    memcpy(state->prior, state->current + 1, state->row_bytes);
+    return 1;
+}
+
+// Skips whitespace and # comments in a PNM header
+static int skip_pnm_space(FILE* file) {
+    int c = fgetc(file);
+    for (;;) {
+        while (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f') {
+            c = fgetc(file);
+        }
+        if (c != '#') {
+            return c;
+        }
+        while (c != EOF && c != '\n' && c != '\r') {
+            c = fgetc(file);
+        }
+    }
+}
+
+static int read_pnm_number(FILE* file, int* value) {
+    int c = skip_pnm_space(file);
+    if (c < '0' || c > '9') {
+        return 0;
+    }
+    long number = 0;
+    while (c >= '0' && c <= '9') {
+        number = number * 10 + (c - '0');
+        if (number > INT_MAX) {
+            return 0;
+        }
+        c = fgetc(file);
+    }
+    *value = (int)number;
+    return 1;  // the single whitespace after the number has been consumed
+}
+
+static int open_pnm(ImageReader* reader, ImageReaderState* state, char kind) {
+    // stbi_load reads 16-bit PNM samples in host byte order, so those are
+    // left to it to keep streamed and loaded pixels identical
+    int max_value;
+    if (!read_pnm_number(state->file, &reader->width) || !read_pnm_number(state->file, &reader->height) ||
+        !read_pnm_number(state->file, &max_value) || reader->width <= 0 || reader->height <= 0 ||
+        max_value <= 0 || max_value > 255) {
+        return 0;
+    }
+
+    reader->channels = kind == '6' ? 3 : 1;
+    return 1;
+}
+
+static int read_pnm_row(ImageReader* reader, ImageReaderState* state, uint8_t* out) {
+    size_t samples = (size_t)reader->width * reader->channels;
+    return fread(out, 1, samples, state->file) == samples;
+}
+
+// Returns NULL without printing an error when the file is not in a
+// streamable format, so callers can fall back to load_image
+ImageReader* open_image_reader(const char* filename) {
+    if (!filename) {
+        fprintf(stderr, "Error: filename is NULL\n");
+        return NULL;
+    }
+
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    ImageReader* reader = calloc(1, sizeof(ImageReader));
+    ImageReaderState* state = calloc(1, sizeof(ImageReaderState));
+    if (!reader || !state) {
+        fprintf(stderr, "Error: failed to allocate memory for image reader\n");
+        free(reader);
+        free(state);
+        fclose(file);
+        return NULL;
+    }
+    reader->state = state;
+    state->file = file;
+
+    static const uint8_t png_signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    uint8_t magic[8];
+    int opened = 0;
+    if (fread(magic, 1, 2, file) == 2 && magic[0] == 'P' && (magic[1] == '5' || magic[1] == '6')) {
+        state->format = STREAM_PNM;
+        opened = open_pnm(reader, state, (char)magic[1]);
+    } else if (fread(magic + 2, 1, 6, file) == 6 && memcmp(magic, png_signature, 8) == 0) {
+        state->format = STREAM_PNG;
+        opened = open_png(reader, state);
+    }
+
+    if (!opened) {
+        close_image_reader(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+// Reads the next count rows into rows (width * channels bytes each).
+// Returns the number of rows read, fewer on a decode error or at the end.
+int read_image_rows(ImageReader* reader, uint8_t* rows, int count) {
+    ImageReaderState* state = reader->state;
+    size_t stride = (size_t)reader->width * reader->channels;
+
+    int read = 0;
+    while (read < count && reader->rows_read < reader->height && !state->failed) {
+        uint8_t* out = rows + read * stride;
+        int ok = state->format == STREAM_PNG ? read_png_row(reader, state, out) : read_pnm_row(reader, state, out);
+        if (!ok) {
+            state->failed = 1;
+            fprintf(stderr, "Error: failed to decode image row %d\n", reader->rows_read);
+            break;
+        }
+        reader->rows_read++;
+        read++;
+    }
+    return read;
+}
+
+void close_image_reader(ImageReader* reader) {
+    if (!reader) {
+        return;
+    }
+    ImageReaderState* state = reader->state;
+    if (state) {
+        if (state->file) fclose(state->file);
+        if (state->inflater) free_inflater(state->inflater);
+        free(state->current);
+        free(state->prior);
+        free(state);
+    }
+    free(reader);
+}
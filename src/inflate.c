@@ -0,0 +1,419 @@
+#include "../include/pixel_art.h"
+#include <pthread.h>
+
+// Zlib/deflate decoder for the streaming PNG reader. Compressed bytes are
+// pulled from an InflateSource as needed and output is produced on demand
+// in whatever amounts the caller asks for, so a whole image never has to
+// be held in memory. Huffman codes up to FAST_BITS long decode with a
+// single table lookup, longer ones through the canonical code ranges.
+
+#define WINDOW_SIZE 32768
+#define WINDOW_MASK (WINDOW_SIZE - 1)
+#define FAST_BITS 10
+#define FAST_MASK ((1 << FAST_BITS) - 1)
+#define INPUT_BUFFER_SIZE 65536
+
+typedef struct {
+    uint16_t fast[1 << FAST_BITS];  // (length << 9) | symbol, 0 when the code is longer
+    uint16_t first_code[16];
+    uint16_t first_symbol[16];
+    uint32_t max_code[17];
+    uint8_t size[288];
+    uint16_t value[288];
+} HuffmanTable;
+
+typedef enum {
+    INFLATE_BLOCK_HEADER,
+    INFLATE_STORED,
+    INFLATE_HUFFMAN,
+    INFLATE_DONE,
+    INFLATE_ERROR
+} InflateState;
+
+struct Inflater {
+    InflateSource source;
+    void* context;
+    uint8_t input[INPUT_BUFFER_SIZE];
+    size_t input_length;
+    size_t input_pos;
+    int input_ended;
+    int padding_bytes;  // zero bytes fed in after the input ended
+
+    uint64_t bits;
+    int bit_count;
+
+    InflateState state;
+    int final_block;
+    size_t stored_remaining;
+    int match_length;  // bytes of the current match still to copy
+    int match_distance;
+
+    const HuffmanTable* literals;
+    const HuffmanTable* distances;
+    HuffmanTable dynamic_literals;
+    HuffmanTable dynamic_distances;
+
+    uint8_t window[WINDOW_SIZE];
+    uint64_t total_out;
+};
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t code_length_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static HuffmanTable fixed_literals;
+static HuffmanTable fixed_distances;
+static pthread_once_t fixed_tables_once = PTHREAD_ONCE_INIT;
+
+static uint32_t reverse_bits(uint32_t code, int length) {
+    uint32_t result = 0;
+    for (int i = 0; i < length; i++) {
+        result = (result << 1) | ((code >> i) & 1);
+    }
+    return result;
+}
+
+// Builds the canonical code for the given code lengths; returns 0 when the
+// lengths oversubscribe the code space
+static int build_huffman(HuffmanTable* table, const uint8_t* lengths, int count) {
+    int sizes[16] = {0};
+    uint32_t next_code[16];
+
+    memset(table->fast, 0, sizeof(table->fast));
+    for (int i = 0; i < count; i++) {
+        sizes[lengths[i]]++;
+    }
+    sizes[0] = 0;
+
+    uint32_t code = 0;
+    int symbol = 0;
+    for (int length = 1; length < 16; length++) {
+        next_code[length] = code;
+        table->first_code[length] = (uint16_t)code;
+        table->first_symbol[length] = (uint16_t)symbol;
+        code += sizes[length];
+        if (sizes[length] && code - 1 >= (1u << length)) {
+            return 0;
+        }
+        table->max_code[length] = code << (16 - length);
+        code <<= 1;
+        symbol += sizes[length];
+    }
+    table->max_code[16] = 0x10000;
+
+    for (int i = 0; i < count; i++) {
+        int length = lengths[i];
+        if (length == 0) {
+            continue;
+        }
+        int index = next_code[length] - table->first_code[length] + table->first_symbol[length];
+        table->size[index] = (uint8_t)length;
+        table->value[index] = (uint16_t)i;
+        if (length <= FAST_BITS) {
+            uint16_t entry = (uint16_t)((length << 9) | i);
+            for (uint32_t j = reverse_bits(next_code[length], length); j < (1u << FAST_BITS); j += 1u << length) {
+                table->fast[j] = entry;
+            }
+        }
+        next_code[length]++;
+    }
+    return 1;
+}
+
+static void build_fixed_tables(void) {
+    uint8_t lengths[288];
+    for (int i = 0; i < 288; i++) {
+        lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+    }
+    build_huffman(&fixed_literals, lengths, 288);
+
+    for (int i = 0; i < 30; i++) {
+        lengths[i] = 5;
+    }
+    build_huffman(&fixed_distances, lengths, 30);
+}
+
+static void refill_bits(Inflater* inflater) {
+    while (inflater->bit_count <= 56) {
+        if (inflater->input_pos == inflater->input_length) {
+            if (inflater->input_ended) {
+                // Past the end of the data: feed zeros, and let
+                // inflate_read notice if any of them get consumed
+                inflater->bit_count += 8;
+                inflater->padding_bytes++;
+                continue;
+            }
+            inflater->input_length = inflater->source(inflater->context, inflater->input, INPUT_BUFFER_SIZE);
+            inflater->input_pos = 0;
+            if (inflater->input_length == 0) {
+                inflater->input_ended = 1;
+                continue;
+            }
+        }
+        inflater->bits |= (uint64_t)inflater->input[inflater->input_pos++] << inflater->bit_count;
+        inflater->bit_count += 8;
+    }
+}
+
+static uint32_t get_bits(Inflater* inflater, int count) {
+    if (inflater->bit_count < count) {
+        refill_bits(inflater);
+    }
+    uint32_t value = (uint32_t)(inflater->bits & ((1u << count) - 1));
+    inflater->bits >>= count;
+    inflater->bit_count -= count;
+    return value;
+}
+
+// Returns the next symbol, or -1 for a code that is not in the table
+static int decode_symbol(Inflater* inflater, const HuffmanTable* table) {
+    if (inflater->bit_count < 16) {
+        refill_bits(inflater);
+    }
+
+    int entry = table->fast[inflater->bits & FAST_MASK];
+    if (entry) {
+        int length = entry >> 9;
+        inflater->bits >>= length;
+        inflater->bit_count -= length;
+        return entry & 511;
+    }
+
+    uint32_t code = reverse_bits((uint32_t)(inflater->bits & 0xFFFF), 16);
+    int length = FAST_BITS + 1;
+    while (length < 16 && code >= table->max_code[length]) {
+        length++;
+    }
+    if (length >= 16) {
+        return -1;
+    }
+
+    int index = (code >> (16 - length)) - table->first_code[length] + table->first_symbol[length];
+    if (index >= 288 || table->size[index] != length) {
+        return -1;
+    }
+    inflater->bits >>= length;
+    inflater->bit_count -= length;
+    return table->value[index];
+}
+
+static int read_dynamic_tables(Inflater* inflater) {
+    int literal_count = get_bits(inflater, 5) + 257;
+    int distance_count = get_bits(inflater, 5) + 1;
+    int code_length_count = get_bits(inflater, 4) + 4;
+
+    uint8_t code_lengths[19] = {0};
+    for (int i = 0; i < code_length_count; i++) {
+        code_lengths[code_length_order[i]] = (uint8_t)get_bits(inflater, 3);
+    }
+
+    HuffmanTable code_length_table;
+    if (!build_huffman(&code_length_table, code_lengths, 19)) {
+        return 0;
+    }
+
+    uint8_t lengths[288 + 32];
+    int total = literal_count + distance_count;
+    int count = 0;
+    while (count < total) {
+        int symbol = decode_symbol(inflater, &code_length_table);
+        if (symbol < 0) {
+            return 0;
+        }
+        if (symbol < 16) {
+            lengths[count++] = (uint8_t)symbol;
+            continue;
+        }
+
+        int repeat;
+        uint8_t value = 0;
+        if (symbol == 16) {
+            if (count == 0) return 0;
+            repeat = 3 + get_bits(inflater, 2);
+            value = lengths[count - 1];
+        } else if (symbol == 17) {
+            repeat = 3 + get_bits(inflater, 3);
+        } else {
+            repeat = 11 + get_bits(inflater, 7);
+        }
+        if (count + repeat > total) {
+            return 0;
+        }
+        memset(lengths + count, value, repeat);
+        count += repeat;
+    }
+
+    if (lengths[256] == 0 ||
+        !build_huffman(&inflater->dynamic_literals, lengths, literal_count) ||
+        !build_huffman(&inflater->dynamic_distances, lengths + literal_count, distance_count)) {
+        return 0;
+    }
+    inflater->literals = &inflater->dynamic_literals;
+    inflater->distances = &inflater->dynamic_distances;
+    return 1;
+}
+
+static int read_block_header(Inflater* inflater) {
+    inflater->final_block = get_bits(inflater, 1);
+    int type = get_bits(inflater, 2);
+
+    if (type == 0) {
+        get_bits(inflater, inflater->bit_count & 7);  // stored blocks start on a byte boundary
+        uint32_t length = get_bits(inflater, 16);
+        uint32_t check = get_bits(inflater, 16);
+        if ((length ^ 0xFFFF) != check) {
+            return 0;
+        }
+        inflater->stored_remaining = length;
+        inflater->state = INFLATE_STORED;
+        return 1;
+    }
+    if (type == 1) {
+        pthread_once(&fixed_tables_once, build_fixed_tables);
+        inflater->literals = &fixed_literals;
+        inflater->distances = &fixed_distances;
+        inflater->state = INFLATE_HUFFMAN;
+        return 1;
+    }
+    if (type == 2 && read_dynamic_tables(inflater)) {
+        inflater->state = INFLATE_HUFFMAN;
+        return 1;
+    }
+    return 0;
+}
+
+static inline void emit_byte(Inflater* inflater, uint8_t value, uint8_t* out) {
+    inflater->window[inflater->total_out & WINDOW_MASK] = value;
+    inflater->total_out++;
+    *out = value;
+}
+
+// Decodes Huffman symbols until length bytes are produced or the block
+// ends; returns the number of bytes produced
+static size_t inflate_huffman(Inflater* inflater, uint8_t* out, size_t length) {
+    size_t produced = 0;
+    while (produced < length) {
+        if (inflater->match_length > 0) {
+            uint64_t from = inflater->total_out - inflater->match_distance;
+            while (inflater->match_length > 0 && produced < length) {
+                emit_byte(inflater, inflater->window[from++ & WINDOW_MASK], out + produced++);
+                inflater->match_length--;
+            }
+            continue;
+        }
+
+        int symbol = decode_symbol(inflater, inflater->literals);
+        if (symbol < 0) {
+            inflater->state = INFLATE_ERROR;
+            break;
+        }
+        if (symbol < 256) {
+            emit_byte(inflater, (uint8_t)symbol, out + produced++);
+            continue;
+        }
+        if (symbol == 256) {
+            inflater->state = inflater->final_block ? INFLATE_DONE : INFLATE_BLOCK_HEADER;
+            break;
+        }
+
+        symbol -= 257;
+        int distance_symbol = -1;
+        if (symbol < 29) {
+            inflater->match_length = length_base[symbol] + get_bits(inflater, length_extra[symbol]);
+            distance_symbol = decode_symbol(inflater, inflater->distances);
+        }
+        if (distance_symbol < 0 || distance_symbol >= 30) {
+            inflater->state = INFLATE_ERROR;
+            break;
+        }
+        inflater->match_distance = distance_base[distance_symbol] + get_bits(inflater, distance_extra[distance_symbol]);
+        if ((uint64_t)inflater->match_distance > inflater->total_out) {
+            inflater->state = INFLATE_ERROR;
+            break;
+        }
+    }
+    return produced;
+}
+
+static size_t inflate_stored(Inflater* inflater, uint8_t* out, size_t length) {
+    size_t produced = 0;
+    while (produced < length && inflater->stored_remaining > 0) {
+        emit_byte(inflater, (uint8_t)get_bits(inflater, 8), out + produced++);
+        inflater->stored_remaining--;
+    }
+    if (inflater->stored_remaining == 0) {
+        inflater->state = inflater->final_block ? INFLATE_DONE : INFLATE_BLOCK_HEADER;
+    }
+    return produced;
+}
+
+Inflater* create_inflater(InflateSource source, void* context) {
+    if (!source) {
+        fprintf(stderr, "Error: invalid parameters for create_inflater\n");
+        return NULL;
+    }
+
+    Inflater* inflater = calloc(1, sizeof(Inflater));
+    if (!inflater) {
+        fprintf(stderr, "Error: failed to allocate memory for inflater\n");
+        return NULL;
+    }
+    inflater->source = source;
+    inflater->context = context;
+
+    // Zlib header: deflate method, window no larger than 32 KB, no preset
+    // dictionary and a valid check value
+    uint32_t cmf = get_bits(inflater, 8);
+    uint32_t flags = get_bits(inflater, 8);
+    if ((cmf & 15) != 8 || (cmf >> 4) > 7 || (flags & 32) || (cmf * 256 + flags) % 31 != 0) {
+        inflater->state = INFLATE_ERROR;
+    }
+    return inflater;
+}
+
+size_t inflate_read(Inflater* inflater, uint8_t* out, size_t length) {
+    size_t produced = 0;
+    while (produced < length) {
+        if (inflater->state == INFLATE_BLOCK_HEADER) {
+            if (!read_block_header(inflater)) {
+                inflater->state = INFLATE_ERROR;
+            }
+        } else if (inflater->state == INFLATE_STORED) {
+            produced += inflate_stored(inflater, out + produced, length - produced);
+        } else if (inflater->state == INFLATE_HUFFMAN) {
+            produced += inflate_huffman(inflater, out + produced, length - produced);
+        } else {
+            break;
+        }
+
+        // Consuming the zero padding means the stream was truncated
+        if (inflater->padding_bytes * 8 > inflater->bit_count) {
+            inflater->state = INFLATE_ERROR;
+        }
+    }
+    return produced;
+}
+
+int inflater_failed(const Inflater* inflater) {
+    return inflater->state == INFLATE_ERROR;
+}
+
+void free_inflater(Inflater* inflater) {
+    free(inflater);
+}
@@ -4,37 +4,383 @@
 #include <getopt.h>
 #include "../include/pixel_art.h"
 
+// Long-only options use values outside the printable character range
+enum {
+    OPT_KMEANS_THRESHOLD = 256,
+    OPT_PNG_LEVEL,
+    OPT_PNG_FILTER,
+    OPT_FAST_PNG,
+    OPT_STAGE_WORKERS,
+    OPT_MAX_IN_FLIGHT,
+    OPT_STREAM,
+    OPT_SAMPLE
+};
+
+// Decoded size above which single conversions stream the image in bands
+#define STREAM_THRESHOLD ((size_t)1 << 30)
+
+// One output of a decode-once, convert-many run: -o SIZE:MODE:PATH
+typedef struct {
+    int pixel_size;
+    ConvertMode mode;
+    int max_colors;
+    const char* path;
+} OutputSpec;
+
+// Low resolution cell grid shared by the palette-mode outputs of one size
+typedef struct {
+    int pixel_size;
+    Image* image;
+} LowResEntry;
+
 void print_usage(const char* program_name) {
     printf("Usage: %s [OPTIONS] input_image output_image\n", program_name);
+    printf("       %s [OPTIONS] -o SPEC [-o SPEC ...] input_image\n", program_name);
+    printf("       %s [OPTIONS] -b input_dir|list_file output_dir\n", program_name);
     printf("\nConvert images to pixel art style\n");
     printf("\nOptions:\n");
     printf("  -s, --size PIXELS     Pixel size (default: 8)\n");
-    printf("  -c, --colors COLORS   For retro mode only (default: 64)\n");
+    printf("  -c, --colors COLORS   Reduce to an adaptive palette of COLORS colors\n");
+    printf("  -q, --quantizer NAME  Palette builder for -c: median (default) or octree\n");
+    printf("  -k, --kmeans ITER     Refine the palette with up to ITER k-means passes\n");
+    printf("      --kmeans-threshold T  Stop k-means once centroids move less than T (default: 1.0)\n");
     printf("  -p, --palette         Use predefined 8-bit palette\n");
     printf("  -n, --no-quantize     Preserve all original colors\n");
+    printf("  -g, --grid            Save one pixel per block (scale stored in PNG metadata)\n");
+    printf("      --sample NAME     Block color: center (default) pixel or average of the block\n");
+    printf("  -o, --output SPEC     Add an output SIZE:MODE:PATH, where MODE is preserve,\n");
+    printf("                        palette or a color count; the input is decoded once\n");
+    printf("  -b, --batch           Convert every image in a directory (or listed in a file,\n");
+    printf("                        one path per line) into output_dir as PNG\n");
+    printf("      --stage-workers D,C,E  Decode, convert and encode workers for -b\n");
+    printf("      --max-in-flight N Most decoded images held at once in -b (default: 2 per\n");
+    printf("                        convert and encode worker)\n");
+    printf("      --stream          Decode and convert in bands of rows to bound memory\n");
+    printf("                        (preserve mode, PNG output; automatic above 1 GiB)\n");
+    printf("  -t, --threads N       Worker threads (default: number of CPUs)\n");
+    printf("      --png-level N     PNG compression level 0-9 (default: %d)\n", PNG_DEFAULT_LEVEL);
+    printf("      --png-filter NAME PNG row filter: auto (default), none, sub, up, average or paeth\n");
+    printf("      --fast-png        Favor PNG encoding speed (level 1, no filtering)\n");
     printf("  -i, --info            Show input image information\n");
     printf("  -h, --help            Show this help message\n");
     printf("\nExamples:\n");
     printf("  %s input.jpg output.png\n", program_name);
     printf("  %s -s 4 photo.jpg pixel_art.png\n", program_name);
     printf("  %s -p -s 16 image.png retro.png\n", program_name);
+    printf("  %s -b -s 16 -c 16 sprites/ pixel_sprites/\n", program_name);
+    printf("  %s -o 4:preserve:fine.png -o 16:palette:retro.png -o 8:32:soft.png photo.jpg\n", program_name);
     printf("\nSupported formats: JPEG, PNG, TGA, BMP, PSD, GIF, HDR, PIC\n");
 }
 
+// Palette modes stay as one index per pixel all the way to the encoder;
+// preserve-colors output keeps the source's channel layout
+typedef struct {
+    Image* image;
+    IndexedImage* indexed;
+} PixelArt;
+
+// low_res, when given, is the input's cell grid at options->pixel_size;
+// table, when given, is the input's summed-area table for block averages
+static PixelArt* convert_input(const Image* input_image, const Image* low_res, const SummedAreaTable* table,
+                               const ConvertOptions* options) {
+    PixelArt* art = calloc(1, sizeof(PixelArt));
+    if (!art) {
+        fprintf(stderr, "Error: failed to allocate memory for pixel art image\n");
+        return NULL;
+    }
+
+    if (options->mode != CONVERT_PRESERVE) {
+        art->indexed = low_res ? convert_low_res_indexed(low_res, input_image->width, input_image->height, options)
+                               : convert_image_indexed(input_image, options);
+    } else {
+        art->image = table ? convert_table_preserve_colors(table, options) : convert_image(input_image, options);
+    }
+    if (!art->indexed && !art->image) {
+        fprintf(stderr, "Error: failed to convert image to pixel art\n");
+        free(art);
+        return NULL;
+    }
+    return art;
+}
+
+// Saves and frees the converted image
+static int save_pixel_art(PixelArt* art, const ConvertOptions* options, const char* output_file) {
+    int scale = options->compact ? options->pixel_size : 0;
+
+    printf("\nSaving pixel art image...\n");
+    int saved;
+    if (art->indexed) {
+        saved = save_indexed_image(output_file, art->indexed, scale);
+        free_indexed_image(art->indexed);
+    } else {
+        saved = scale > 0 ? save_image_with_scale(output_file, art->image, scale)
+                          : save_image(output_file, art->image);
+        free_image(art->image);
+    }
+    free(art);
+
+    if (!saved) {
+        fprintf(stderr, "Error: failed to save output image\n");
+    }
+    return saved;
+}
+
+static int convert_and_save(const Image* input_image, const Image* low_res, const SummedAreaTable* table,
+                            const ConvertOptions* options, const char* output_file) {
+    PixelArt* art = convert_input(input_image, low_res, table, options);
+    return art ? save_pixel_art(art, options, output_file) : 0;
+}
+
+static int parse_output_spec(const char* text, OutputSpec* spec) {
+    const char* mode = strchr(text, ':');
+    const char* path = mode ? strchr(mode + 1, ':') : NULL;
+    if (!path || path[1] == '\0') {
+        fprintf(stderr, "Error: output spec '%s' must be SIZE:MODE:PATH\n", text);
+        return 0;
+    }
+
+    spec->pixel_size = atoi(text);
+    spec->path = path + 1;
+    if (spec->pixel_size <= 0) {
+        fprintf(stderr, "Error: pixel size must be positive in output spec '%s'\n", text);
+        return 0;
+    }
+
+    size_t mode_length = path - (mode + 1);
+    if (mode_length == 8 && strncmp(mode + 1, "preserve", 8) == 0) {
+        spec->mode = CONVERT_PRESERVE;
+    } else if (mode_length == 7 && strncmp(mode + 1, "palette", 7) == 0) {
+        spec->mode = CONVERT_PALETTE;
+    } else {
+        spec->mode = CONVERT_ADAPTIVE;
+        spec->max_colors = atoi(mode + 1);
+        if (spec->max_colors <= 0) {
+            fprintf(stderr, "Error: output spec '%s' needs preserve, palette or a positive color count\n", text);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Returns the cell grid for pixel_size, building it once. Every grid is
+// averaged from the input itself (or its summed-area table, when one was
+// built), so an output does not depend on which other specs were given.
+static Image* shared_low_res(const Image* input_image, const SummedAreaTable* table, LowResEntry* cache,
+                             int* cache_count, int pixel_size) {
+    for (int i = 0; i < *cache_count; i++) {
+        if (cache[i].pixel_size == pixel_size) {
+            return cache[i].image;
+        }
+    }
+
+    Image* image = table ? create_low_res_from_table(table, pixel_size)
+                         : create_low_res_image(input_image, pixel_size);
+    if (image) {
+        cache[*cache_count].pixel_size = pixel_size;
+        cache[*cache_count].image = image;
+        (*cache_count)++;
+    }
+    return image;
+}
+
+// Decode-once, convert-many mode: every spec is rendered from one decoded
+// input, and palette-mode specs of one size share their cell grid.
+static int convert_outputs(const char* input_file, const ConvertOptions* base_options,
+                           const OutputSpec* specs, int spec_count, int show_info) {
+    printf("Image to Pixel Art Converter\n");
+    printf("============================\n");
+    printf("Input file: %s\n", input_file);
+    printf("Outputs: %d\n", spec_count);
+    printf("Threads: %d\n", get_thread_count());
+    printf("\n");
+
+    printf("Loading image...\n");
+    Image* input_image = load_image(input_file);
+    if (!input_image) {
+        fprintf(stderr, "Error: failed to load input image\n");
+        return 0;
+    }
+
+    if (show_info) {
+        print_image_info(input_image);
+        printf("\n");
+    }
+
+    // One table serves every block size, so build it once up front
+    SummedAreaTable* table = NULL;
+    if (base_options->sample == SAMPLE_AVERAGE && !(table = create_summed_area_table(input_image))) {
+        free_image(input_image);
+        return 0;
+    }
+
+    LowResEntry* cache = malloc(spec_count * sizeof(LowResEntry));
+    if (!cache) {
+        fprintf(stderr, "Error: failed to allocate memory for output specs\n");
+        free_summed_area_table(table);
+        free_image(input_image);
+        return 0;
+    }
+    int cache_count = 0;
+
+    int failures = 0;
+    for (int i = 0; i < spec_count; i++) {
+        ConvertOptions options = *base_options;
+        options.pixel_size = specs[i].pixel_size;
+        options.mode = specs[i].mode;
+        if (specs[i].mode == CONVERT_ADAPTIVE) {
+            options.max_colors = specs[i].max_colors;
+        }
+
+        printf("\n[%d/%d] %s\n", i + 1, spec_count, specs[i].path);
+        const Image* low_res = NULL;
+        if (options.mode != CONVERT_PRESERVE) {
+            low_res = shared_low_res(input_image, table, cache, &cache_count, options.pixel_size);
+            if (!low_res) {
+                failures++;
+                continue;
+            }
+        }
+
+        if (convert_and_save(input_image, low_res, table, &options, specs[i].path)) {
+            printf("Pixel art saved to: %s\n", specs[i].path);
+        } else {
+            failures++;
+        }
+    }
+
+    for (int i = 0; i < cache_count; i++) {
+        free_image(cache[i].image);
+    }
+    free(cache);
+    free_summed_area_table(table);
+    free_image(input_image);
+
+    if (failures > 0) {
+        fprintf(stderr, "Error: %d of %d outputs failed\n", failures, spec_count);
+        return 0;
+    }
+    printf("\nConversion complete! %d outputs saved\n", spec_count);
+    return 1;
+}
+
+static void* decode_batch_file(const char* input, void* context) {
+    (void)context;
+    return load_image(input);
+}
+
+static void* convert_batch_image(void* decoded, void* context) {
+    PixelArt* art = convert_input(decoded, NULL, NULL, context);
+    free_image(decoded);
+    return art;
+}
+
+static int encode_batch_image(void* converted, const char* output, void* context) {
+    return save_pixel_art(converted, context, output);
+}
+
+static int convert_directory(const char* source, const char* output_dir, const ConvertOptions* options,
+                             const PipelineConfig* pipeline) {
+    printf("Image to Pixel Art Converter\n");
+    printf("============================\n");
+    printf("Batch input: %s\n", source);
+    printf("Output directory: %s\n", output_dir);
+    printf("Pixel size: %d\n", options->pixel_size);
+    printf("Threads: %d\n", get_thread_count());
+    printf("\n");
+
+    BatchJob* job = create_batch_job(source, output_dir);
+    if (!job) {
+        return 0;
+    }
+
+    BatchStages stages = {decode_batch_file, convert_batch_image, encode_batch_image};
+    int converted = run_batch_job(job, &stages, (void*)options, pipeline);
+    int result = converted == job->count;
+    if (!result) {
+        fprintf(stderr, "Error: %d of %d images failed\n", job->count - converted, job->count);
+    }
+    free_batch_job(job);
+    return result;
+}
+
+// Converts without ever holding the whole image when the input can be read
+// in rows and the conversion only needs one band at a time. Returns 1 or 0
+// for success or failure, or -1 when the caller should load the image.
+static int convert_streamed(const char* input_file, const char* output_file, const ConvertOptions* options,
+                            int force, int show_info) {
+    const char* ext = strrchr(output_file, '.');
+    int png_output = ext && (strcmp(ext, ".png") == 0 || strcmp(ext, ".PNG") == 0);
+    if (options->mode != CONVERT_PRESERVE || options->sample != SAMPLE_CENTER || !png_output) {
+        if (force) {
+            printf("Streaming needs preserve mode, center sampling and PNG output; loading the whole image\n");
+        }
+        return -1;
+    }
+
+    ImageReader* reader = open_image_reader(input_file);
+    if (!reader) {
+        if (force) {
+            printf("Input cannot be streamed (only PNG and binary PPM/PGM); loading the whole image\n");
+        }
+        return -1;
+    }
+
+    size_t decoded_size = (size_t)reader->width * reader->height * reader->channels;
+    if (!force && decoded_size < STREAM_THRESHOLD) {
+        close_image_reader(reader);
+        return -1;
+    }
+
+    if (show_info) {
+        printf("Image: %dx%d, %d channels (streamed)\n\n", reader->width, reader->height, reader->channels);
+    }
+    int result = convert_stream_preserve_colors(reader, options, output_file);
+    close_image_reader(reader);
+    if (!result) {
+        fprintf(stderr, "Error: failed to convert image to pixel art\n");
+    }
+    return result;
+}
+
 int main(int argc, char* argv[]) {
-    int pixel_size = 8;
-    int max_colors = 64;
+    ConvertOptions options;
+    init_convert_options(&options);
+    int limit_colors = 0;
     int use_palette = 0;
     int preserve_colors = 0;
     int show_info = 0;
     char* input_file = NULL;
     char* output_file = NULL;
+    int single_output_flags = 0;
+    int batch = 0;
+    int pipeline_flags = 0;
+    PipelineConfig pipeline;
+    init_pipeline_config(&pipeline);
+    OutputSpec* outputs = NULL;
+    int output_count = 0;
+    int png_level = PNG_DEFAULT_LEVEL;
+    PngFilter png_filter = PNG_FILTER_AUTO;
+    int stream = 0;
 
     static struct option long_options[] = {
         {"size",        required_argument, 0, 's'},
         {"colors",      required_argument, 0, 'c'},
+        {"quantizer",   required_argument, 0, 'q'},
+        {"kmeans",      required_argument, 0, 'k'},
+        {"kmeans-threshold", required_argument, 0, OPT_KMEANS_THRESHOLD},
         {"palette",     no_argument,       0, 'p'},
         {"no-quantize", no_argument,       0, 'n'},
+        {"grid",        no_argument,       0, 'g'},
+        {"output",      required_argument, 0, 'o'},
+        {"batch",       no_argument,       0, 'b'},
+        {"threads",     required_argument, 0, 't'},
+        {"png-level",   required_argument, 0, OPT_PNG_LEVEL},
+        {"png-filter",  required_argument, 0, OPT_PNG_FILTER},
+        {"fast-png",    no_argument,       0, OPT_FAST_PNG},
+        {"stage-workers", required_argument, 0, OPT_STAGE_WORKERS},
+        {"max-in-flight", required_argument, 0, OPT_MAX_IN_FLIGHT},
+        {"stream",      no_argument,       0, OPT_STREAM},
+        {"sample",      required_argument, 0, OPT_SAMPLE},
         {"info",        no_argument,       0, 'i'},
         {"help",        no_argument,       0, 'h'},
         {0, 0, 0, 0}
@@ -43,28 +389,147 @@ int main(int argc, char* argv[]) {
     int option_index = 0;
     int c;
 
-    while ((c = getopt_long(argc, argv, "s:c:pnih", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "s:c:q:k:pngo:bt:ih", long_options, &option_index)) != -1) {
         switch (c) {
             case 's':
-                pixel_size = atoi(optarg);
-                if (pixel_size <= 0) {
+                single_output_flags = 1;
+                options.pixel_size = atoi(optarg);
+                if (options.pixel_size <= 0) {
                     fprintf(stderr, "Error: pixel size must be positive\n");
                     return 1;
                 }
                 break;
             case 'c':
-                max_colors = atoi(optarg);
-                if (max_colors <= 0) {
+                single_output_flags = 1;
+                options.max_colors = atoi(optarg);
+                if (options.max_colors <= 0) {
                     fprintf(stderr, "Error: number of colors must be positive\n");
                     return 1;
                 }
+                limit_colors = 1;
+                break;
+            case 'q':
+                if (strcmp(optarg, "median") == 0) {
+                    options.quantizer = QUANTIZER_MEDIAN_CUT;
+                } else if (strcmp(optarg, "octree") == 0) {
+                    options.quantizer = QUANTIZER_OCTREE;
+                } else {
+                    fprintf(stderr, "Error: unknown quantizer '%s' (expected median or octree)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'k':
+                options.kmeans_iterations = atoi(optarg);
+                if (options.kmeans_iterations <= 0) {
+                    fprintf(stderr, "Error: k-means iterations must be positive\n");
+                    return 1;
+                }
+                break;
+            case OPT_KMEANS_THRESHOLD:
+                options.kmeans_threshold = atof(optarg);
+                if (options.kmeans_threshold < 0.0) {
+                    fprintf(stderr, "Error: k-means threshold must not be negative\n");
+                    return 1;
+                }
                 break;
             case 'p':
+                single_output_flags = 1;
                 use_palette = 1;
                 break;
             case 'n':
+                single_output_flags = 1;
                 preserve_colors = 1;
                 break;
+            case 'g':
+                options.compact = 1;
+                break;
+            case 'o':
+                // Never more specs than arguments
+                if (!outputs && !(outputs = calloc(argc, sizeof(OutputSpec)))) {
+                    fprintf(stderr, "Error: failed to allocate memory for output specs\n");
+                    return 1;
+                }
+                if (!parse_output_spec(optarg, &outputs[output_count])) {
+                    free(outputs);
+                    return 1;
+                }
+                output_count++;
+                break;
+            case 'b':
+                batch = 1;
+                break;
+            case OPT_STAGE_WORKERS:
+                pipeline_flags = 1;
+                if (sscanf(optarg, "%d,%d,%d", &pipeline.decode_workers, &pipeline.convert_workers,
+                           &pipeline.encode_workers) != 3 ||
+                    pipeline.decode_workers <= 0 || pipeline.convert_workers <= 0 || pipeline.encode_workers <= 0) {
+                    fprintf(stderr, "Error: stage workers must be three positive counts, e.g. 1,6,1\n");
+                    return 1;
+                }
+                break;
+            case OPT_MAX_IN_FLIGHT:
+                pipeline_flags = 1;
+                pipeline.max_in_flight = atoi(optarg);
+                if (pipeline.max_in_flight <= 0) {
+                    fprintf(stderr, "Error: max in-flight images must be positive\n");
+                    return 1;
+                }
+                break;
+            case OPT_SAMPLE:
+                if (strcmp(optarg, "center") == 0) {
+                    options.sample = SAMPLE_CENTER;
+                } else if (strcmp(optarg, "average") == 0) {
+                    options.sample = SAMPLE_AVERAGE;
+                } else {
+                    fprintf(stderr, "Error: unknown sampler '%s' (expected center or average)\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_STREAM:
+                stream = 1;
+                break;
+            case 't': {
+                int threads = atoi(optarg);
+                if (threads <= 0) {
+                    fprintf(stderr, "Error: thread count must be positive\n");
+                    return 1;
+                }
+                set_thread_count(threads);
+                break;
+            }
+            case OPT_PNG_LEVEL: {
+                char* end;
+                long level = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || level < 0 || level > 9) {
+                    fprintf(stderr, "Error: PNG compression level must be between 0 and 9\n");
+                    return 1;
+                }
+                png_level = (int)level;
+                break;
+            }
+            case OPT_PNG_FILTER: {
+                static const char* filter_names[] = {"none", "sub", "up", "average", "paeth"};
+                if (strcmp(optarg, "auto") == 0) {
+                    png_filter = PNG_FILTER_AUTO;
+                    break;
+                }
+                int found = 0;
+                for (int i = 0; i < 5; i++) {
+                    if (strcmp(optarg, filter_names[i]) == 0) {
+                        png_filter = (PngFilter)i;
+                        found = 1;
+                    }
+                }
+                if (!found) {
+                    fprintf(stderr, "Error: unknown PNG filter '%s' (expected auto, none, sub, up, average or paeth)\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case OPT_FAST_PNG:
+                png_level = 1;
+                png_filter = PNG_FILTER_NONE;
+                break;
             case 'i':
                 show_info = 1;
                 break;
@@ -79,6 +544,58 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    set_png_options(png_level, png_filter);
+
+    if (preserve_colors) {
+        options.mode = CONVERT_PRESERVE;
+    } else if (use_palette) {
+        options.mode = CONVERT_PALETTE;
+    } else if (limit_colors) {
+        options.mode = CONVERT_ADAPTIVE;
+    } else {
+        options.mode = CONVERT_PRESERVE;
+    }
+
+    if (pipeline_flags && !batch) {
+        fprintf(stderr, "Error: --stage-workers and --max-in-flight require --batch\n");
+        free(outputs);
+        return 1;
+    }
+
+    if (stream && (batch || output_count > 0)) {
+        fprintf(stderr, "Error: --stream needs a single input and output file\n");
+        free(outputs);
+        return 1;
+    }
+
+    if (batch) {
+        if (output_count > 0) {
+            fprintf(stderr, "Error: --batch cannot be combined with --output\n");
+            free(outputs);
+            return 1;
+        }
+        if (optind + 2 != argc) {
+            fprintf(stderr, "Error: batch mode needs an input directory or list file and an output directory\n");
+            print_usage(argv[0]);
+            return 1;
+        }
+        return convert_directory(argv[optind], argv[optind + 1], &options, &pipeline) ? 0 : 1;
+    }
+
+    if (output_count > 0) {
+        int result = 1;
+        if (single_output_flags) {
+            fprintf(stderr, "Error: -s, -c, -p and -n cannot be combined with --output\n");
+        } else if (optind + 1 != argc) {
+            fprintf(stderr, "Error: exactly one input file is required with --output\n");
+            print_usage(argv[0]);
+        } else {
+            result = convert_outputs(argv[optind], &options, outputs, output_count, show_info) ? 0 : 1;
+        }
+        free(outputs);
+        return result;
+    }
+
     if (optind + 2 != argc) {
         fprintf(stderr, "Error: input and output files are required\n");
         print_usage(argv[0]);
@@ -92,16 +609,34 @@ int main(int argc, char* argv[]) {
     printf("============================\n");
     printf("Input file: %s\n", input_file);
     printf("Output file: %s\n", output_file);
-    printf("Pixel size: %d\n", pixel_size);
+    printf("Pixel size: %d\n", options.pixel_size);
+    printf("Threads: %d\n", get_thread_count());
+    if (options.compact) {
+        printf("Output: one pixel per block\n");
+    }
+    if (options.sample == SAMPLE_AVERAGE) {
+        printf("Sampling: block average\n");
+    }
     if (preserve_colors) {
         printf("Mode: Preserve original colors (blockiness only)\n");
     } else if (use_palette) {
         printf("Using predefined 8-bit palette\n");
+    } else if (limit_colors) {
+        printf("Max colors: %d\n", options.max_colors);
     } else {
-        printf("Max colors: %d\n", max_colors);
+        printf("Mode: Preserve original colors (default)\n");
     }
     printf("\n");
 
+    int streamed = convert_streamed(input_file, output_file, &options, stream, show_info);
+    if (streamed >= 0) {
+        if (!streamed) {
+            return 1;
+        }
+        printf("\nConversion complete! Pixel art saved to: %s\n", output_file);
+        return 0;
+    }
+
     printf("Loading image...\n");
     Image* input_image = load_image(input_file);
     if (!input_image) {
@@ -114,33 +649,14 @@ int main(int argc, char* argv[]) {
         printf("\n");
     }
 
-    Image* pixel_art_image;
-    if (preserve_colors) {
-        pixel_art_image = convert_to_pixel_art_preserve_colors(input_image, pixel_size);
-    } else if (use_palette) {
-        pixel_art_image = convert_to_pixel_art_with_palette(input_image, pixel_size);
-    } else {
-        pixel_art_image = convert_to_pixel_art(input_image, pixel_size, max_colors);
-    }
-
-    if (!pixel_art_image) {
-        fprintf(stderr, "Error: failed to convert image to pixel art\n");
-        free_image(input_image);
-        return 1;
-    }
-
-    printf("\nSaving pixel art image...\n");
-    if (!save_image(output_file, pixel_art_image)) {
-        fprintf(stderr, "Error: failed to save output image\n");
+    if (!convert_and_save(input_image, NULL, NULL, &options, output_file)) {
         free_image(input_image);
-        free_image(pixel_art_image);
         return 1;
     }
 
     printf("\nConversion complete! Pixel art saved to: %s\n", output_file);
 
     free_image(input_image);
-    free_image(pixel_art_image);
 
     return 0;
 }
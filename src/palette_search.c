@@ -0,0 +1,224 @@
+#include "../include/pixel_art.h"
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PALETTE_SEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+typedef int (*PaletteSearchKernel)(const PaletteLanes* lanes, int r, int g, int b);
+
+// Padding entries sit far outside the RGB cube, so they always lose to a
+// real entry without overflowing the 32-bit squared distance
+#define LANE_PADDING_VALUE 1024
+
+PaletteLanes* create_palette_lanes(const Palette* palette) {
+    if (!palette || palette->count == 0) {
+        fprintf(stderr, "Error: invalid parameters for create_palette_lanes\n");
+        return NULL;
+    }
+
+    PaletteLanes* lanes = malloc(sizeof(PaletteLanes));
+    if (!lanes) {
+        fprintf(stderr, "Error: failed to allocate memory for palette lanes\n");
+        return NULL;
+    }
+
+    int capacity = (palette->count + PALETTE_LANE_WIDTH - 1) / PALETTE_LANE_WIDTH * PALETTE_LANE_WIDTH;
+    lanes->count = palette->count;
+    lanes->capacity = capacity;
+    lanes->storage = malloc(3 * capacity * sizeof(int32_t) + PALETTE_LANE_ALIGN - 1);
+    if (!lanes->storage) {
+        fprintf(stderr, "Error: failed to allocate memory for palette lanes\n");
+        free(lanes);
+        return NULL;
+    }
+
+    // The capacity is a multiple of the lane width, so aligning the first
+    // lane keeps all three aligned
+    uintptr_t base = ((uintptr_t)lanes->storage + PALETTE_LANE_ALIGN - 1) & ~(uintptr_t)(PALETTE_LANE_ALIGN - 1);
+    lanes->r = (int32_t*)base;
+    lanes->g = lanes->r + capacity;
+    lanes->b = lanes->g + capacity;
+
+    for (int i = 0; i < capacity; i++) {
+        if (i < palette->count) {
+            lanes->r[i] = palette->colors[i].r;
+            lanes->g[i] = palette->colors[i].g;
+            lanes->b[i] = palette->colors[i].b;
+        } else {
+            lanes->r[i] = LANE_PADDING_VALUE;
+            lanes->g[i] = LANE_PADDING_VALUE;
+            lanes->b[i] = LANE_PADDING_VALUE;
+        }
+    }
+    return lanes;
+}
+
+void free_palette_lanes(PaletteLanes* lanes) {
+    if (lanes) {
+        free(lanes->storage);
+        free(lanes);
+    }
+}
+
+static int search_scalar(const PaletteLanes* lanes, int r, int g, int b) {
+    int best_index = 0;
+    int best_distance = INT32_MAX;
+    for (int i = 0; i < lanes->count; i++) {
+        int dr = r - lanes->r[i];
+        int dg = g - lanes->g[i];
+        int db = b - lanes->b[i];
+        int distance = dr * dr + dg * dg + db * db;
+        if (distance < best_distance) {
+            best_distance = distance;
+            best_index = i;
+        }
+    }
+    return best_index;
+}
+
+#ifdef PALETTE_SEARCH_X86
+
+// Reduces per-lane winners to the overall nearest entry, preferring the
+// lowest index among equal distances like the scalar search. The vector
+// kernels run over the padded capacity, so they need no scalar tail.
+static void reduce_lanes(const int32_t* distances, const int32_t* indices, int width,
+                         int* best_index, int* best_distance) {
+    for (int i = 0; i < width; i++) {
+        if (distances[i] < *best_distance ||
+            (distances[i] == *best_distance && indices[i] < *best_index)) {
+            *best_distance = distances[i];
+            *best_index = indices[i];
+        }
+    }
+}
+
+__attribute__((target("sse4.1")))
+static int search_sse41(const PaletteLanes* lanes, int r, int g, int b) {
+    const __m128i vr = _mm_set1_epi32(r);
+    const __m128i vg = _mm_set1_epi32(g);
+    const __m128i vb = _mm_set1_epi32(b);
+    const __m128i step = _mm_set1_epi32(4);
+    __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i best_distance = _mm_set1_epi32(INT32_MAX);
+    __m128i best_index = _mm_setzero_si128();
+
+    for (int i = 0; i < lanes->capacity; i += 4) {
+        __m128i dr = _mm_sub_epi32(_mm_load_si128((const __m128i*)(lanes->r + i)), vr);
+        __m128i dg = _mm_sub_epi32(_mm_load_si128((const __m128i*)(lanes->g + i)), vg);
+        __m128i db = _mm_sub_epi32(_mm_load_si128((const __m128i*)(lanes->b + i)), vb);
+        __m128i distance = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(dr, dr), _mm_mullo_epi32(dg, dg)),
+                                         _mm_mullo_epi32(db, db));
+        __m128i closer = _mm_cmplt_epi32(distance, best_distance);
+        best_distance = _mm_blendv_epi8(best_distance, distance, closer);
+        best_index = _mm_blendv_epi8(best_index, index, closer);
+        index = _mm_add_epi32(index, step);
+    }
+
+    int32_t distances[4], indices[4];
+    _mm_storeu_si128((__m128i*)distances, best_distance);
+    _mm_storeu_si128((__m128i*)indices, best_index);
+
+    int result = 0, result_distance = INT32_MAX;
+    reduce_lanes(distances, indices, 4, &result, &result_distance);
+    return result;
+}
+
+__attribute__((target("avx2")))
+static int search_avx2(const PaletteLanes* lanes, int r, int g, int b) {
+    const __m256i vr = _mm256_set1_epi32(r);
+    const __m256i vg = _mm256_set1_epi32(g);
+    const __m256i vb = _mm256_set1_epi32(b);
+    const __m256i step = _mm256_set1_epi32(8);
+    __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i best_distance = _mm256_set1_epi32(INT32_MAX);
+    __m256i best_index = _mm256_setzero_si256();
+
+    for (int i = 0; i < lanes->capacity; i += 8) {
+        __m256i dr = _mm256_sub_epi32(_mm256_load_si256((const __m256i*)(lanes->r + i)), vr);
+        __m256i dg = _mm256_sub_epi32(_mm256_load_si256((const __m256i*)(lanes->g + i)), vg);
+        __m256i db = _mm256_sub_epi32(_mm256_load_si256((const __m256i*)(lanes->b + i)), vb);
+        __m256i distance = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(dr, dr),
+                                                             _mm256_mullo_epi32(dg, dg)),
+                                            _mm256_mullo_epi32(db, db));
+        __m256i closer = _mm256_cmpgt_epi32(best_distance, distance);
+        best_distance = _mm256_blendv_epi8(best_distance, distance, closer);
+        best_index = _mm256_blendv_epi8(best_index, index, closer);
+        index = _mm256_add_epi32(index, step);
+    }
+
+    int32_t distances[8], indices[8];
+    _mm256_storeu_si256((__m256i*)distances, best_distance);
+    _mm256_storeu_si256((__m256i*)indices, best_index);
+
+    int result = 0, result_distance = INT32_MAX;
+    reduce_lanes(distances, indices, 8, &result, &result_distance);
+    return result;
+}
+
+__attribute__((target("avx512f")))
+static int search_avx512(const PaletteLanes* lanes, int r, int g, int b) {
+    const __m512i vr = _mm512_set1_epi32(r);
+    const __m512i vg = _mm512_set1_epi32(g);
+    const __m512i vb = _mm512_set1_epi32(b);
+    const __m512i step = _mm512_set1_epi32(16);
+    __m512i index = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i best_distance = _mm512_set1_epi32(INT32_MAX);
+    __m512i best_index = _mm512_setzero_si512();
+
+    for (int i = 0; i < lanes->capacity; i += 16) {
+        __m512i dr = _mm512_sub_epi32(_mm512_load_si512(lanes->r + i), vr);
+        __m512i dg = _mm512_sub_epi32(_mm512_load_si512(lanes->g + i), vg);
+        __m512i db = _mm512_sub_epi32(_mm512_load_si512(lanes->b + i), vb);
+        __m512i distance = _mm512_add_epi32(_mm512_add_epi32(_mm512_mullo_epi32(dr, dr),
+                                                             _mm512_mullo_epi32(dg, dg)),
+                                            _mm512_mullo_epi32(db, db));
+        __mmask16 closer = _mm512_cmplt_epi32_mask(distance, best_distance);
+        best_distance = _mm512_mask_blend_epi32(closer, best_distance, distance);
+        best_index = _mm512_mask_blend_epi32(closer, best_index, index);
+        index = _mm512_add_epi32(index, step);
+    }
+
+    int32_t distances[16], indices[16];
+    _mm512_storeu_si512(distances, best_distance);
+    _mm512_storeu_si512(indices, best_index);
+
+    int result = 0, result_distance = INT32_MAX;
+    reduce_lanes(distances, indices, 16, &result, &result_distance);
+    return result;
+}
+
+#endif
+
+static pthread_once_t search_kernel_once = PTHREAD_ONCE_INIT;
+static PaletteSearchKernel search_kernel = search_scalar;
+static const char* search_kernel_name = "scalar";
+
+// Picks the widest kernel the running CPU supports; the binary itself is
+// built for the baseline target, so one build serves every host
+static void select_search_kernel(void) {
+#ifdef PALETTE_SEARCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        search_kernel = search_avx512;
+        search_kernel_name = "avx512";
+    } else if (__builtin_cpu_supports("avx2")) {
+        search_kernel = search_avx2;
+        search_kernel_name = "avx2";
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        search_kernel = search_sse41;
+        search_kernel_name = "sse4.1";
+    }
+#endif
+}
+
+const char* palette_search_kernel_name(void) {
+    pthread_once(&search_kernel_once, select_search_kernel);
+    return search_kernel_name;
+}
+
+int palette_lanes_nearest(const PaletteLanes* lanes, uint8_t r, uint8_t g, uint8_t b) {
+    pthread_once(&search_kernel_once, select_search_kernel);
+    return search_kernel(lanes, r, g, b);
+}
@@ -1,17 +1,68 @@
 #include "../include/pixel_art.h"
 
-Image* convert_to_pixel_art(const Image* src, int pixel_size, int max_colors) {
-    if (!src || !src->data || pixel_size <= 0) {
-        fprintf(stderr, "Error: invalid parameters for convert_to_pixel_art\n");
+// Copies the center pixel of each block along one source row
+static void sample_cell_row(const uint8_t* sample_row, uint8_t* dst_row, int width, int channels, int pixel_size) {
+    int grid_width = (width + pixel_size - 1) / pixel_size;
+    for (int cell_x = 0; cell_x < grid_width; cell_x++) {
+        int sample_x = cell_x * pixel_size + pixel_size / 2;
+        if (sample_x >= width) sample_x = width - 1;
+        memcpy(dst_row + cell_x * channels, sample_row + sample_x * channels, channels);
+    }
+}
+
+// One pixel per block, sampled at the block center like the full size
+// preserve-colors output. Ragged edge blocks get their own cell.
+static Image* sample_block_centers(const Image* src, int pixel_size) {
+    int grid_width = (src->width + pixel_size - 1) / pixel_size;
+    int grid_height = (src->height + pixel_size - 1) / pixel_size;
+
+    printf("Sampling %dx%d block centers (compact output)\n", grid_width, grid_height);
+
+    Image* dst = malloc(sizeof(Image));
+    if (!dst) {
+        fprintf(stderr, "Error: failed to allocate memory for pixel art image\n");
         return NULL;
     }
 
-    (void)max_colors;
-    return convert_to_pixel_art_preserve_colors(src, pixel_size);
-}
+    dst->width = grid_width;
+    dst->height = grid_height;
+    dst->channels = src->channels;
+    dst->data = malloc((size_t)grid_width * grid_height * src->channels);
+    if (!dst->data) {
+        fprintf(stderr, "Error: failed to allocate memory for pixel art image data\n");
+        free(dst);
+        return NULL;
+    }
+
+    size_t stride = (size_t)src->width * src->channels;
+    for (int cell_y = 0; cell_y < grid_height; cell_y++) {
+        int sample_y = cell_y * pixel_size + pixel_size / 2;
+        if (sample_y >= src->height) sample_y = src->height - 1;
+
+        sample_cell_row(src->data + sample_y * stride, dst->data + (size_t)cell_y * grid_width * src->channels,
+                        src->width, src->channels, pixel_size);
+    }
 
+    return dst;
+}
 
+void init_convert_options(ConvertOptions* options) {
+    options->mode = CONVERT_PRESERVE;
+    options->pixel_size = 8;
+    options->max_colors = 64;
+    options->quantizer = QUANTIZER_MEDIAN_CUT;
+    options->kmeans_iterations = 0;
+    options->kmeans_threshold = 1.0;
+    options->compact = 0;
+    options->sample = SAMPLE_CENTER;
+}
 
+static void refine_palette(Palette* palette, const Image* low_res, const ConvertOptions* options) {
+    if (options->kmeans_iterations > 0) {
+        printf("Refining palette with k-means (max %d iterations)\n", options->kmeans_iterations);
+        refine_palette_kmeans(palette, low_res, options->kmeans_iterations, options->kmeans_threshold);
+    }
+}
 
 Palette* create_8bit_palette() {
     Palette* palette = create_palette(256);
@@ -46,55 +97,445 @@ Palette* create_8bit_palette() {
     return palette;
 }
 
-Image* convert_to_pixel_art_with_palette(const Image* src, int pixel_size) {
+// Palette matching works on RGB, so gray and gray+alpha cells are widened
+// to RGB and RGBA. Only the small low resolution image is converted.
+static Image* expand_gray_to_rgb(Image* img) {
+    if (img->channels >= 3) {
+        return img;
+    }
+
+    int channels = img->channels == 2 ? 4 : 3;
+    uint8_t* data = malloc((size_t)img->width * img->height * channels);
+    if (!data) {
+        fprintf(stderr, "Error: failed to allocate memory for RGB conversion\n");
+        free_image(img);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < (size_t)img->width * img->height; i++) {
+        const uint8_t* in = img->data + i * img->channels;
+        uint8_t* out = data + i * channels;
+        out[0] = out[1] = out[2] = in[0];
+        if (channels == 4) {
+            out[3] = in[1];
+        }
+    }
+
+    free(img->data);
+    img->data = data;
+    img->channels = channels;
+    return img;
+}
+
+static void print_palette_mode(const ConvertOptions* options) {
+    if (options->mode == CONVERT_ADAPTIVE) {
+        printf("Converting image to pixel art with up to %d colors (pixel_size=%d)\n",
+               options->max_colors, options->pixel_size);
+    } else {
+        printf("Converting image to pixel art with 8-bit palette (pixel_size=%d)\n", options->pixel_size);
+    }
+}
+
+// Cell edges for blocks of pixel_size; a ragged last block is its own cell
+static int* block_edges(int size, int pixel_size, int* count) {
+    *count = (size + pixel_size - 1) / pixel_size;
+    int* edges = malloc((*count + 1) * sizeof(int));
+    if (edges) {
+        for (int i = 0; i < *count; i++) {
+            edges[i] = i * pixel_size;
+        }
+        edges[*count] = size;
+    }
+    return edges;
+}
+
+// One RGB(A) cell per block, the integer mean of the pixels it covers.
+// Blocks are pixel_size wide like in preserve mode, with a ragged last
+// block when the size does not divide the image. Palette modes work on this
+// image, so it can be shared by every conversion at one block size.
+Image* create_low_res_image(const Image* src, int pixel_size) {
     if (!src || !src->data || pixel_size <= 0) {
-        fprintf(stderr, "Error: invalid parameters for convert_to_pixel_art_with_palette\n");
+        fprintf(stderr, "Error: invalid parameters for create_low_res_image\n");
         return NULL;
     }
 
-    printf("Converting image to pixel art with 8-bit palette (pixel_size=%d)\n", pixel_size);
+    int low_width, low_height;
+    int* x_edges = block_edges(src->width, pixel_size, &low_width);
+    int* y_edges = block_edges(src->height, pixel_size, &low_height);
 
-    int low_width = src->width / pixel_size;
-    int low_height = src->height / pixel_size;
-    
+    printf("Step 1: Averaging blocks into low resolution (%dx%d)\n", low_width, low_height);
+    Image* low_res = NULL;
+    if (x_edges && y_edges) {
+        low_res = box_reduce_cells(src, x_edges, low_width, y_edges, low_height);
+    }
+    free(x_edges);
+    free(y_edges);
+
+    if (low_res) {
+        low_res = expand_gray_to_rgb(low_res);
+    }
+    if (!low_res) {
+        fprintf(stderr, "Error: failed to create low resolution image\n");
+    }
+    return low_res;
+}
+
+// Same cells as create_low_res_image, read from a summed-area table. The
+// table can serve any number of block sizes.
+Image* create_low_res_from_table(const SummedAreaTable* table, int pixel_size) {
+    if (!table || pixel_size <= 0) {
+        fprintf(stderr, "Error: invalid parameters for create_low_res_from_table\n");
+        return NULL;
+    }
 
-    if (low_width < 1) low_width = 1;
-    if (low_height < 1) low_height = 1;
+    int low_width, low_height;
+    int* x_edges = block_edges(table->width, pixel_size, &low_width);
+    int* y_edges = block_edges(table->height, pixel_size, &low_height);
 
-    printf("Step 1: Resizing to low resolution (%dx%d)\n", low_width, low_height);
-    Image* low_res = resize_image(src, low_width, low_height);
+    printf("Step 1: Averaging blocks from the summed-area table (%dx%d)\n", low_width, low_height);
+    Image* low_res = NULL;
+    if (x_edges && y_edges) {
+        low_res = summed_area_cells(table, x_edges, low_width, y_edges, low_height);
+    }
+    free(x_edges);
+    free(y_edges);
+
+    if (low_res) {
+        low_res = expand_gray_to_rgb(low_res);
+    }
     if (!low_res) {
         fprintf(stderr, "Error: failed to create low resolution image\n");
+    }
+    return low_res;
+}
+
+// Builds the palette for the adaptive and 8-bit palette modes. The palette
+// is derived from the low resolution image, so its cost depends on the cell
+// count rather than the input size.
+static Palette* create_cell_palette(const Image* low_res, const ConvertOptions* options) {
+    Palette* palette;
+    if (options->mode == CONVERT_PALETTE) {
+        printf("Step 2: Quantizing colors using 8-bit palette\n");
+        palette = create_8bit_palette();
+    } else if (options->quantizer == QUANTIZER_OCTREE) {
+        printf("Step 2: Building adaptive palette using octree\n");
+        palette = create_octree_palette(low_res, options->max_colors);
+    } else {
+        printf("Step 2: Building adaptive palette using median cut\n");
+        palette = create_median_cut_palette(low_res, options->max_colors);
+    }
+    if (palette) {
+        refine_palette(palette, low_res, options);
+    }
+    return palette;
+}
+
+static Palette* prepare_palette(const Image* src, const ConvertOptions* options, Image** low_res_out) {
+    print_palette_mode(options);
+
+    Image* low_res = create_low_res_image(src, options->pixel_size);
+    if (!low_res) {
         return NULL;
     }
 
-    printf("Step 2: Quantizing colors using 8-bit palette\n");
-    Palette* palette = create_8bit_palette();
+    Palette* palette = create_cell_palette(low_res, options);
     if (!palette) {
         free_image(low_res);
         return NULL;
     }
 
-    Image* quantized = quantize_colors(low_res, palette);
+    *low_res_out = low_res;
+    return palette;
+}
+
+static int valid_palette_options(const ConvertOptions* options) {
+    return options && options->pixel_size > 0 && options->mode != CONVERT_PRESERVE &&
+           (options->mode != CONVERT_ADAPTIVE || options->max_colors > 0);
+}
+
+typedef struct {
+    const Image* low_res;
+    const Palette* palette;
+    IndexedImage* dst;
+    const int* cell_x;  // low resolution column for every output column
+    const int* cell_y;  // low resolution row for every output row
+    int failed;
+} IndexFillContext;
+
+// Maps each row of cells to palette indices once and writes the enlarged
+// rows straight into the output; rows that repeat a cell row are copied
+static void fill_index_rows(void* context, int start, int end, int worker) {
+    IndexFillContext* ctx = context;
+    const Image* low_res = ctx->low_res;
+    IndexedImage* dst = ctx->dst;
+    int channels = low_res->channels;
+    (void)worker;
+
+    uint8_t* mapped = malloc(low_res->width);
+    if (!mapped) {
+        ctx->failed = 1;
+        return;
+    }
+
+    for (int y = start; y < end; y++) {
+        uint8_t* out = dst->indices + (size_t)y * dst->width;
+        uint8_t* alpha = dst->alpha ? dst->alpha + (size_t)y * dst->width : NULL;
+        if (y > start && ctx->cell_y[y] == ctx->cell_y[y - 1]) {
+            memcpy(out, out - dst->width, dst->width);
+            if (alpha) memcpy(alpha, alpha - dst->width, dst->width);
+            continue;
+        }
+
+        const uint8_t* cells = low_res->data + (size_t)ctx->cell_y[y] * low_res->width * channels;
+        for (int x = 0; x < low_res->width; x++) {
+            const uint8_t* cell = cells + x * channels;
+            mapped[x] = (uint8_t)palette_lut_nearest(ctx->palette, cell[0], cell[1], cell[2]);
+        }
+        for (int x = 0; x < dst->width; x++) {
+            out[x] = mapped[ctx->cell_x[x]];
+        }
+        if (alpha) {
+            for (int x = 0; x < dst->width; x++) {
+                alpha[x] = cells[ctx->cell_x[x] * channels + 3];
+            }
+        }
+    }
+
+    free(mapped);
+}
+
+// Maps every cell to its palette index and writes the indexed output in a
+// single pass: enlarged to width x height, or the cell grid itself for
+// compact output. No full size RGB or index image of the cells is built.
+static IndexedImage* map_cells_indexed(const Image* low_res, Palette* palette, int width, int height,
+                                       const ConvertOptions* options) {
+    if (options->compact) {
+        width = low_res->width;
+        height = low_res->height;
+        printf("Step 3: Mapping %dx%d cells to %d colors (compact output)\n",
+               low_res->width, low_res->height, palette->count);
+    } else {
+        printf("Step 3: Mapping %dx%d cells to %d colors and filling %dx%d output\n",
+               low_res->width, low_res->height, palette->count, width, height);
+    }
+    if (!build_palette_lut(palette)) {
+        fprintf(stderr, "Error: failed to quantize colors\n");
+        return NULL;
+    }
+
+    // An alpha plane is only kept when some cell is not fully opaque
+    int has_alpha = 0;
+    if (low_res->channels == 4) {
+        for (size_t i = 0; i < (size_t)low_res->width * low_res->height && !has_alpha; i++) {
+            has_alpha = low_res->data[i * 4 + 3] != 255;
+        }
+    }
+
+    IndexedImage* dst = create_indexed_image(width, height, palette, has_alpha);
+    int* cell_x = malloc(width * sizeof(int));
+    int* cell_y = malloc(height * sizeof(int));
+    if (!dst || !cell_x || !cell_y) {
+        fprintf(stderr, "Error: failed to allocate memory for pixel art image data\n");
+        free_indexed_image(dst);
+        free(cell_x);
+        free(cell_y);
+        return NULL;
+    }
+
+    // Output pixel x lies in block x / pixel_size, as in preserve mode
+    int scale = options->compact ? 1 : options->pixel_size;
+    for (int x = 0; x < width; x++) cell_x[x] = x / scale;
+    for (int y = 0; y < height; y++) cell_y[y] = y / scale;
+
+    IndexFillContext ctx = {low_res, palette, dst, cell_x, cell_y, 0};
+    parallel_for(height, 0, fill_index_rows, &ctx);
+    free(cell_x);
+    free(cell_y);
+
+    if (ctx.failed) {
+        fprintf(stderr, "Error: failed to allocate memory for pixel art image data\n");
+        free_indexed_image(dst);
+        return NULL;
+    }
+    return dst;
+}
+
+IndexedImage* convert_image_indexed(const Image* src, const ConvertOptions* options) {
+    if (!src || !src->data || !valid_palette_options(options)) {
+        fprintf(stderr, "Error: invalid parameters for convert_image_indexed\n");
+        return NULL;
+    }
+
+    Image* low_res;
+    Palette* palette = prepare_palette(src, options, &low_res);
+    if (!palette) {
+        return NULL;
+    }
+
+    IndexedImage* pixel_art = map_cells_indexed(low_res, palette, src->width, src->height, options);
     free_image(low_res);
     free_palette(palette);
-    if (!quantized) {
-        fprintf(stderr, "Error: failed to quantize colors\n");
+    return pixel_art;
+}
+
+// Same as convert_image_indexed for a low resolution image that was already
+// built by create_low_res_image or create_low_res_from_table at the same
+// block size. width and height give the full output size; compact output is
+// the cell grid itself.
+IndexedImage* convert_low_res_indexed(const Image* low_res, int width, int height, const ConvertOptions* options) {
+    if (!low_res || !low_res->data || low_res->channels < 3 || width <= 0 || height <= 0 ||
+        !valid_palette_options(options) ||
+        low_res->width != (width + options->pixel_size - 1) / options->pixel_size ||
+        low_res->height != (height + options->pixel_size - 1) / options->pixel_size) {
+        fprintf(stderr, "Error: invalid parameters for convert_low_res_indexed\n");
+        return NULL;
+    }
+
+    print_palette_mode(options);
+    printf("Step 1: Reusing low resolution image (%dx%d)\n", low_res->width, low_res->height);
+
+    Palette* palette = create_cell_palette(low_res, options);
+    if (!palette) {
+        return NULL;
+    }
+
+    IndexedImage* pixel_art = map_cells_indexed(low_res, palette, width, height, options);
+    free_palette(palette);
+    return pixel_art;
+}
+
+// Palette modes for callers that want RGB(A) pixels: the indexed
+// conversion expanded through its palette
+static Image* convert_with_palette(const Image* src, const ConvertOptions* options) {
+    IndexedImage* indexed = convert_image_indexed(src, options);
+    if (!indexed) {
         return NULL;
     }
 
-    printf("Step 3: Scaling back up to %dx%d using nearest neighbor\n", src->width, src->height);
-    Image* pixel_art = resize_nearest_neighbor(quantized, src->width, src->height);
-    free_image(quantized);
+    Image* pixel_art = indexed_to_image(indexed);
+    free_indexed_image(indexed);
     if (!pixel_art) {
-        fprintf(stderr, "Error: failed to scale up pixel art\n");
         return NULL;
     }
 
-    printf("Pixel art conversion with palette complete!\n");
+    printf("Pixel art conversion with %s palette complete!\n",
+           options->mode == CONVERT_ADAPTIVE ? "adaptive" : "8-bit");
     return pixel_art;
 }
 
+typedef struct {
+    const Image* src;
+    Image* dst;
+    int pixel_size;
+    int cells;  // src already holds one pixel per block
+} BlockBandContext;
+
+// Repeats one pixel span times. 3 and 4 channel images get dedicated loops
+// so the compiler can keep the pixel in registers.
+static inline void fill_span(const uint8_t* sample, uint8_t* out, int span, int channels) {
+    if (channels == 4) {
+        uint32_t pixel;
+        memcpy(&pixel, sample, 4);
+        for (int x = 0; x < span; x++) {
+            memcpy(out + x * 4, &pixel, 4);
+        }
+    } else if (channels == 3) {
+        uint8_t r = sample[0], g = sample[1], b = sample[2];
+        for (int x = 0; x < span; x++) {
+            out[x * 3] = r;
+            out[x * 3 + 1] = g;
+            out[x * 3 + 2] = b;
+        }
+    } else {
+        for (int x = 0; x < span; x++) {
+            for (int c = 0; c < channels; c++) {
+                out[x * channels + c] = sample[c];
+            }
+        }
+    }
+}
+
+// Builds one output row of a block band: every block's span is filled with
+// the color sampled from its center. Common block sizes use the specialized
+// fill kernels.
+static void fill_band_row(const uint8_t* sample_row, uint8_t* dst_row, int width, int channels, int pixel_size) {
+    int block_x = 0;
+
+    BlockFillKernel kernel = find_block_fill_kernel(pixel_size, channels);
+    if (kernel) {
+        // Full blocks only; a ragged last block samples a clamped column
+        int full_blocks = width / pixel_size;
+        kernel(sample_row + (pixel_size / 2) * channels, pixel_size * channels, dst_row, full_blocks);
+        block_x = full_blocks * pixel_size;
+    }
+
+    for (; block_x < width; block_x += pixel_size) {
+        int sample_x = block_x + pixel_size / 2;
+        if (sample_x >= width) sample_x = width - 1;
+
+        int span = width - block_x < pixel_size ? width - block_x : pixel_size;
+        fill_span(sample_row + sample_x * channels, dst_row + block_x * channels, span, channels);
+    }
+}
+
+// Same as fill_band_row for a row of ready-made cells, one per block
+static void fill_cell_row(const uint8_t* cell_row, uint8_t* dst_row, int width, int channels, int pixel_size) {
+    int block_x = 0;
+
+    BlockFillKernel kernel = find_block_fill_kernel(pixel_size, channels);
+    if (kernel) {
+        int full_blocks = width / pixel_size;
+        kernel(cell_row, channels, dst_row, full_blocks);
+        block_x = full_blocks * pixel_size;
+    }
+
+    for (; block_x < width; block_x += pixel_size) {
+        int span = width - block_x < pixel_size ? width - block_x : pixel_size;
+        fill_span(cell_row + (block_x / pixel_size) * channels, dst_row + block_x * channels, span, channels);
+    }
+}
+
+static void fill_block_bands(void* context, int start, int end, int worker) {
+    const BlockBandContext* ctx = context;
+    const Image* src = ctx->src;
+    Image* dst = ctx->dst;
+    int pixel_size = ctx->pixel_size;
+    size_t src_stride = (size_t)src->width * src->channels;
+    size_t stride = (size_t)dst->width * dst->channels;
+    (void)worker;
+
+    for (int band = start; band < end; band++) {
+        int block_y = band * pixel_size;
+        int band_end = block_y + pixel_size < dst->height ? block_y + pixel_size : dst->height;
+        uint8_t* first_row = dst->data + block_y * stride;
+
+        // Every row of a band is identical, so build the first one and copy it
+        if (ctx->cells) {
+            fill_cell_row(src->data + band * src_stride, first_row, dst->width, dst->channels, pixel_size);
+        } else {
+            int sample_y = block_y + pixel_size / 2;
+            if (sample_y >= src->height) sample_y = src->height - 1;
+            fill_band_row(src->data + sample_y * src_stride, first_row, dst->width, dst->channels, pixel_size);
+        }
+        for (int y = block_y + 1; y < band_end; y++) {
+            memcpy(dst->data + y * stride, first_row, stride);
+        }
+    }
+}
+
+Image* convert_to_pixel_art_with_palette(const Image* src, int pixel_size) {
+    if (!src || !src->data || pixel_size <= 0) {
+        fprintf(stderr, "Error: invalid parameters for convert_to_pixel_art_with_palette\n");
+        return NULL;
+    }
+
+    ConvertOptions options;
+    init_convert_options(&options);
+    options.mode = CONVERT_PALETTE;
+    options.pixel_size = pixel_size;
+    return convert_with_palette(src, &options);
+}
+
 Image* convert_to_pixel_art_preserve_colors(const Image* src, int pixel_size) {
     if (!src || !src->data || pixel_size <= 0) {
         fprintf(stderr, "Error: invalid parameters for convert_to_pixel_art_preserve_colors\n");
@@ -122,29 +563,180 @@ Image* convert_to_pixel_art_preserve_colors(const Image* src, int pixel_size) {
 
     printf("Creating pixel blocks of size %dx%d with original colors\n", pixel_size, pixel_size);
 
-    for (int block_y = 0; block_y < src->height; block_y += pixel_size) {
-        for (int block_x = 0; block_x < src->width; block_x += pixel_size) {
+    // Each band of block rows writes a disjoint range of output rows, so the
+    // bands can be processed concurrently without synchronization
+    int band_count = (src->height + pixel_size - 1) / pixel_size;
+    BlockBandContext ctx = {src, dst, pixel_size, 0};
+    parallel_for(band_count, 0, fill_block_bands, &ctx);
 
-            int sample_x = block_x + pixel_size / 2;
-            int sample_y = block_y + pixel_size / 2;
+    printf("High-quality pixel art conversion complete!\n");
+    return dst;
+}
 
-            if (sample_x >= src->width) sample_x = src->width - 1;
-            if (sample_y >= src->height) sample_y = src->height - 1;
+// Preserve-colors conversion straight from a row reader to a PNG file. Only
+// the center row of each band of blocks is kept, so memory is one input row
+// plus one band of output rather than both full images.
+int convert_stream_preserve_colors(ImageReader* reader, const ConvertOptions* options, const char* output_file) {
+    if (!reader || !options || options->pixel_size <= 0 || !output_file) {
+        fprintf(stderr, "Error: invalid parameters for convert_stream_preserve_colors\n");
+        return 0;
+    }
+
+    int width = reader->width;
+    int height = reader->height;
+    int channels = reader->channels;
+    int pixel_size = options->pixel_size;
+    int out_width = options->compact ? (width + pixel_size - 1) / pixel_size : width;
+    int out_height = options->compact ? (height + pixel_size - 1) / pixel_size : height;
+    int band_rows = options->compact ? 1 : pixel_size;
+    size_t stride = (size_t)width * channels;
+    size_t out_stride = (size_t)out_width * channels;
 
-            int sample_idx = (sample_y * src->width + sample_x) * src->channels;
+    printf("Streaming %dx%d image in bands of %d rows (pixel_size=%d, no color reduction)\n",
+           width, height, pixel_size, pixel_size);
+
+    uint8_t* row = malloc(stride);
+    uint8_t* band = malloc(out_stride * band_rows);
+    if (!row || !band) {
+        fprintf(stderr, "Error: failed to allocate memory for pixel art band\n");
+        free(row);
+        free(band);
+        return 0;
+    }
 
-            for (int y = block_y; y < block_y + pixel_size && y < src->height; y++) {
-                for (int x = block_x; x < block_x + pixel_size && x < src->width; x++) {
-                    int dst_idx = (y * dst->width + x) * dst->channels;
+    PngStream* stream = open_png_stream(output_file, out_width, out_height, channels,
+                                        options->compact ? pixel_size : 0);
+    int ok = stream != NULL;
 
-                    for (int c = 0; c < src->channels; c++) {
-                        dst->data[dst_idx + c] = src->data[sample_idx + c];
-                    }
+    for (int block_y = 0; ok && block_y < height; block_y += pixel_size) {
+        int sample_y = block_y + pixel_size / 2;
+        if (sample_y >= height) sample_y = height - 1;
+        int band_end = block_y + pixel_size < height ? block_y + pixel_size : height;
+
+        // Decode the whole band but keep only the row blocks are sampled from
+        for (int y = block_y; ok && y < band_end; y++) {
+            ok = read_image_rows(reader, row, 1) == 1;
+            if (ok && y == sample_y) {
+                if (options->compact) {
+                    sample_cell_row(row, band, width, channels, pixel_size);
+                } else {
+                    fill_band_row(row, band, width, channels, pixel_size);
                 }
             }
         }
+        if (!ok) {
+            break;
+        }
+
+        int rows = options->compact ? 1 : band_end - block_y;
+        for (int y = 1; y < rows; y++) {
+            memcpy(band + y * out_stride, band, out_stride);
+        }
+        ok = write_png_stream_rows(stream, band, rows);
     }
 
-    printf("High-quality pixel art conversion complete!\n");
+    if (stream) {
+        ok = close_png_stream(stream) && ok;
+    }
+    free(row);
+    free(band);
+
+    if (ok) {
+        printf("Streaming pixel art conversion complete!\n");
+    }
+    return ok;
+}
+
+// Preserve-colors output where every block takes the mean color of its
+// pixels instead of the center pixel, which avoids aliasing on noisy input.
+// Any number of block sizes can be rendered from one table.
+Image* convert_table_preserve_colors(const SummedAreaTable* table, const ConvertOptions* options) {
+    if (!table || !options || options->pixel_size <= 0) {
+        fprintf(stderr, "Error: invalid parameters for convert_table_preserve_colors\n");
+        return NULL;
+    }
+
+    int pixel_size = options->pixel_size;
+    int grid_width, grid_height;
+    int* x_edges = block_edges(table->width, pixel_size, &grid_width);
+    int* y_edges = block_edges(table->height, pixel_size, &grid_height);
+    Image* cells = NULL;
+    if (x_edges && y_edges) {
+        printf("Averaging %dx%d blocks of %dx%d pixels\n", grid_width, grid_height, pixel_size, pixel_size);
+        cells = summed_area_cells(table, x_edges, grid_width, y_edges, grid_height);
+    } else {
+        fprintf(stderr, "Error: failed to allocate memory for block edges\n");
+    }
+    free(x_edges);
+    free(y_edges);
+    if (!cells || options->compact) {
+        return cells;
+    }
+
+    Image* dst = malloc(sizeof(Image));
+    if (dst) {
+        dst->width = table->width;
+        dst->height = table->height;
+        dst->channels = table->channels;
+        dst->data = malloc((size_t)dst->width * dst->height * dst->channels);
+    }
+    if (!dst || !dst->data) {
+        fprintf(stderr, "Error: failed to allocate memory for pixel art image data\n");
+        free(dst);
+        free_image(cells);
+        return NULL;
+    }
+
+    BlockBandContext ctx = {cells, dst, pixel_size, 1};
+    parallel_for(grid_height, 0, fill_block_bands, &ctx);
+    free_image(cells);
+
+    printf("Block-average pixel art conversion complete!\n");
     return dst;
 }
+
+static Image* convert_averaged(const Image* src, const ConvertOptions* options) {
+    SummedAreaTable* table = create_summed_area_table(src);
+    if (!table) {
+        return NULL;
+    }
+    Image* dst = convert_table_preserve_colors(table, options);
+    free_summed_area_table(table);
+    return dst;
+}
+
+Image* convert_image(const Image* src, const ConvertOptions* options) {
+    if (!src || !src->data || !options || options->pixel_size <= 0) {
+        fprintf(stderr, "Error: invalid parameters for convert_image\n");
+        return NULL;
+    }
+
+    switch (options->mode) {
+        case CONVERT_ADAPTIVE:
+        case CONVERT_PALETTE:
+            return convert_with_palette(src, options);
+        case CONVERT_PRESERVE:
+        default:
+            if (options->sample == SAMPLE_AVERAGE) {
+                return convert_averaged(src, options);
+            }
+            if (options->compact) {
+                return sample_block_centers(src, options->pixel_size);
+            }
+            return convert_to_pixel_art_preserve_colors(src, options->pixel_size);
+    }
+}
+
+Image* convert_to_pixel_art(const Image* src, int pixel_size, int max_colors) {
+    if (!src || !src->data || pixel_size <= 0 || max_colors <= 0) {
+        fprintf(stderr, "Error: invalid parameters for convert_to_pixel_art\n");
+        return NULL;
+    }
+
+    ConvertOptions options;
+    init_convert_options(&options);
+    options.mode = CONVERT_ADAPTIVE;
+    options.pixel_size = pixel_size;
+    options.max_colors = max_colors;
+    return convert_with_palette(src, &options);
+}
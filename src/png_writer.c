@@ -0,0 +1,535 @@
+#include "../include/pixel_art.h"
+#include <pthread.h>
+
+#define PALETTIZE_HASH_SIZE 1024  // power of two, comfortably above 256 colors
+#define PNG_STREAM_FLUSH_SIZE (1024 * 1024)  // filtered bytes buffered per IDAT chunk
+#define FILTER_MIN_WORKER_BYTES (128 * 1024)  // smallest share of rows worth a handoff
+
+static int png_compression_level = PNG_DEFAULT_LEVEL;
+static PngFilter png_filter = PNG_FILTER_AUTO;
+
+void set_png_options(int compression_level, PngFilter filter) {
+    if (compression_level < 0) compression_level = 0;
+    if (compression_level > 9) compression_level = 9;
+    png_compression_level = compression_level;
+    png_filter = filter;
+}
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
+
+static void build_crc_table(void) {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[n] = c;
+    }
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t length) {
+    pthread_once(&crc_table_once, build_crc_table);
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void put_be32(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+static int write_chunk(FILE* file, const char* type, const uint8_t* data, size_t length) {
+    uint8_t header[8];
+    uint8_t footer[4];
+    put_be32(header, (uint32_t)length);
+    memcpy(header + 4, type, 4);
+    put_be32(footer, crc32_update(crc32_update(0, header + 4, 4), data, length));
+
+    return fwrite(header, 1, 8, file) == 8 &&
+           (length == 0 || fwrite(data, 1, length, file) == length) &&
+           fwrite(footer, 1, 4, file) == 4;
+}
+
+// "PixelScale\0<scale>": records the factor a renderer should upscale by
+static int write_scale_chunk(FILE* file, int scale) {
+    char text[32];
+    int length = snprintf(text, sizeof(text), "PixelScale%c%d", 0, scale);
+    return write_chunk(file, "tEXt", (const uint8_t*)text, length);
+}
+
+static inline uint8_t paeth_predictor(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return (uint8_t)a;
+    if (pb <= pc) return (uint8_t)b;
+    return (uint8_t)c;
+}
+
+// Applies one PNG filter to a row; prior is NULL for the first row, which
+// the filters treat as a row of zeros. The first bpp bytes have no left
+// neighbour and are handled before each loop.
+static void filter_row(int filter, const uint8_t* row, const uint8_t* prior, size_t length, int bpp, uint8_t* out) {
+    size_t lead = (size_t)bpp < length ? (size_t)bpp : length;
+    if (!prior && (filter == PNG_FILTER_UP || filter == PNG_FILTER_PAETH)) {
+        // Up degenerates to None and Paeth to Sub on the first row
+        filter = filter == PNG_FILTER_UP ? PNG_FILTER_NONE : PNG_FILTER_SUB;
+    }
+
+    switch (filter) {
+        case PNG_FILTER_SUB:
+            for (size_t i = 0; i < lead; i++) out[i] = row[i];
+            for (size_t i = lead; i < length; i++) out[i] = (uint8_t)(row[i] - row[i - bpp]);
+            break;
+        case PNG_FILTER_UP:
+            for (size_t i = 0; i < length; i++) out[i] = (uint8_t)(row[i] - prior[i]);
+            break;
+        case PNG_FILTER_AVERAGE:
+            if (prior) {
+                for (size_t i = 0; i < lead; i++) out[i] = (uint8_t)(row[i] - (prior[i] >> 1));
+                for (size_t i = lead; i < length; i++) {
+                    out[i] = (uint8_t)(row[i] - ((row[i - bpp] + prior[i]) >> 1));
+                }
+            } else {
+                for (size_t i = 0; i < lead; i++) out[i] = row[i];
+                for (size_t i = lead; i < length; i++) out[i] = (uint8_t)(row[i] - (row[i - bpp] >> 1));
+            }
+            break;
+        case PNG_FILTER_PAETH:
+            for (size_t i = 0; i < lead; i++) out[i] = (uint8_t)(row[i] - prior[i]);
+            for (size_t i = lead; i < length; i++) {
+                out[i] = (uint8_t)(row[i] - paeth_predictor(row[i - bpp], prior[i], prior[i - bpp]));
+            }
+            break;
+        default:
+            memcpy(out, row, length);
+            break;
+    }
+}
+
+// Adaptive filtering: pick the filter with the smallest sum of absolute
+// residuals per row, the heuristic recommended by the PNG specification
+static int choose_filter(const uint8_t* row, const uint8_t* prior, size_t length, int bpp, uint8_t* scratch) {
+    int best_filter = PNG_FILTER_NONE;
+    uint64_t best_cost = UINT64_MAX;
+    for (int filter = PNG_FILTER_NONE; filter <= PNG_FILTER_PAETH; filter++) {
+        filter_row(filter, row, prior, length, bpp, scratch);
+        uint64_t cost = 0;
+        for (size_t i = 0; i < length; i++) {
+            int residual = (int8_t)scratch[i];
+            cost += (uint64_t)(residual < 0 ? -residual : residual);
+        }
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_filter = filter;
+        }
+    }
+    return best_filter;
+}
+
+typedef struct {
+    const uint8_t* rows;
+    const uint8_t* first_prior;  // row above rows[0], NULL at the top of the image
+    uint8_t* raw;
+    size_t row_bytes;
+    int bpp;
+    PngFilter filter;
+    int failed;
+} FilterContext;
+
+// Rows only depend on the unfiltered source, so bands filter independently
+static void filter_rows(void* context, int start, int end, int worker) {
+    (void)worker;
+    FilterContext* ctx = context;
+    size_t row_bytes = ctx->row_bytes;
+    uint8_t* scratch = NULL;
+    if (ctx->filter == PNG_FILTER_AUTO) {
+        scratch = malloc(row_bytes);
+        if (!scratch) {
+            ctx->failed = 1;
+            return;
+        }
+    }
+
+    for (int y = start; y < end; y++) {
+        const uint8_t* row = ctx->rows + y * row_bytes;
+        const uint8_t* prior = y > 0 ? row - row_bytes : ctx->first_prior;
+        int row_filter = ctx->filter == PNG_FILTER_AUTO ? choose_filter(row, prior, row_bytes, ctx->bpp, scratch)
+                                                        : (int)ctx->filter;
+
+        uint8_t* out = ctx->raw + y * (row_bytes + 1);
+        out[0] = (uint8_t)row_filter;
+        filter_row(row_filter, row, prior, row_bytes, ctx->bpp, out + 1);
+    }
+
+    free(scratch);
+}
+
+// Filters height rows of row_bytes packed samples each into raw as filter
+// byte + row. prior is the row above the first one, NULL at the top.
+static int filter_band(const uint8_t* rows, const uint8_t* prior, int height, size_t row_bytes, int bpp,
+                       PngFilter filter, uint8_t* raw) {
+    FilterContext ctx = {rows, prior, raw, row_bytes, bpp, filter, 0};
+
+    // Streamed bands are often only a few rows; those stay on this thread
+    size_t worker_limit = (size_t)height * row_bytes / FILTER_MIN_WORKER_BYTES;
+    int workers = parallel_worker_count(height);
+    if ((size_t)workers > worker_limit) workers = worker_limit > 0 ? (int)worker_limit : 1;
+    parallel_for(height, workers, filter_rows, &ctx);
+    if (ctx.failed) {
+        fprintf(stderr, "Error: failed to allocate memory for PNG scanlines\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Builds the filtered scanline stream (filter byte + row) for the image.
+static uint8_t* filter_scanlines(const uint8_t* rows, int height, size_t row_bytes, int bpp,
+                                 PngFilter filter, size_t* raw_size) {
+    *raw_size = (row_bytes + 1) * height;
+    uint8_t* raw = malloc(*raw_size);
+    if (!raw) {
+        fprintf(stderr, "Error: failed to allocate memory for PNG scanlines\n");
+        return NULL;
+    }
+
+    if (!filter_band(rows, NULL, height, row_bytes, bpp, filter, raw)) {
+        free(raw);
+        return NULL;
+    }
+    return raw;
+}
+
+// Signature, IHDR and the optional scale note
+static int write_png_header(FILE* file, int width, int height, int bit_depth, int color_type, int scale) {
+    uint8_t ihdr[13];
+    put_be32(ihdr, (uint32_t)width);
+    put_be32(ihdr + 4, (uint32_t)height);
+    ihdr[8] = (uint8_t)bit_depth;
+    ihdr[9] = (uint8_t)color_type;
+    ihdr[10] = 0;
+    ihdr[11] = 0;
+    ihdr[12] = 0;
+
+    static const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    return fwrite(signature, 1, 8, file) == 8 &&
+           write_chunk(file, "IHDR", ihdr, sizeof(ihdr)) &&
+           (scale <= 0 || write_scale_chunk(file, scale));
+}
+
+// Writes a complete PNG. rows holds packed samples for the given bit depth
+// and color type; palette data is only used for indexed images.
+static int write_png_file(const char* filename, const uint8_t* rows, int width, int height,
+                          int bit_depth, int color_type, int channels, PngFilter filter,
+                          const uint8_t* plte, int plte_count, const uint8_t* trns, int trns_count, int scale) {
+    size_t row_bytes = ((size_t)width * channels * bit_depth + 7) / 8;
+    int bpp = (channels * bit_depth + 7) / 8;
+
+    size_t raw_size;
+    uint8_t* raw = filter_scanlines(rows, height, row_bytes, bpp, filter, &raw_size);
+    if (!raw) {
+        return 0;
+    }
+
+    size_t compressed_size = 0;
+    uint8_t* compressed = zlib_compress(raw, raw_size, png_compression_level, &compressed_size);
+    free(raw);
+    if (!compressed) {
+        fprintf(stderr, "Error: failed to compress PNG data\n");
+        return 0;
+    }
+
+    FILE* file = fopen(filename, "wb");
+    int result = 0;
+    if (file) {
+        result = write_png_header(file, width, height, bit_depth, color_type, scale) &&
+                 (plte_count == 0 || write_chunk(file, "PLTE", plte, plte_count * 3)) &&
+                 (trns_count == 0 || write_chunk(file, "tRNS", trns, trns_count)) &&
+                 write_chunk(file, "IDAT", compressed, compressed_size) &&
+                 write_chunk(file, "IEND", NULL, 0);
+        result = fclose(file) == 0 && result;
+    }
+
+    free(compressed);
+    return result;
+}
+
+int write_indexed_png(const char* filename, const uint8_t* indices, int width, int height,
+                      const Color* colors, const uint8_t* alpha, int color_count, int scale) {
+    if (!filename || !indices || !colors || width <= 0 || height <= 0 ||
+        color_count <= 0 || color_count > 256) {
+        fprintf(stderr, "Error: invalid parameters for write_indexed_png\n");
+        return 0;
+    }
+
+    // Smallest bit depth that can address every palette entry
+    int bit_depth = color_count <= 2 ? 1 : color_count <= 4 ? 2 : color_count <= 16 ? 4 : 8;
+    int pixels_per_byte = 8 / bit_depth;
+    size_t row_bytes = ((size_t)width + pixels_per_byte - 1) / pixels_per_byte;
+
+    uint8_t* rows = NULL;
+    if (bit_depth < 8) {
+        rows = calloc(row_bytes * height, 1);
+        if (!rows) {
+            fprintf(stderr, "Error: failed to allocate memory for PNG scanlines\n");
+            return 0;
+        }
+        for (int y = 0; y < height; y++) {
+            uint8_t* row = rows + y * row_bytes;
+            const uint8_t* in = indices + (size_t)y * width;
+            for (int x = 0; x < width; x++) {
+                int shift = 8 - bit_depth * (x % pixels_per_byte + 1);
+                row[x / pixels_per_byte] |= (uint8_t)(in[x] << shift);
+            }
+        }
+    }
+
+    uint8_t plte[256 * 3];
+    for (int i = 0; i < color_count; i++) {
+        plte[i * 3] = colors[i].r;
+        plte[i * 3 + 1] = colors[i].g;
+        plte[i * 3 + 2] = colors[i].b;
+    }
+
+    // tRNS only needs to run up to the last entry that is not fully opaque
+    int trns_count = 0;
+    if (alpha) {
+        for (int i = 0; i < color_count; i++) {
+            if (alpha[i] != 255) trns_count = i + 1;
+        }
+    }
+
+    // Filtering rarely helps palette indices, so the automatic choice is none
+    PngFilter filter = png_filter == PNG_FILTER_AUTO ? PNG_FILTER_NONE : png_filter;
+    int result = write_png_file(filename, rows ? rows : indices, width, height, bit_depth, 3, 1, filter,
+                                plte, color_count, alpha, trns_count, scale);
+    free(rows);
+    return result;
+}
+
+// Maps an RGB(A) image to at most 256 distinct colors. Returns the number
+// of colors, or 0 when the image has more colors than an indexed PNG can
+// hold.
+static int palettize_image(const Image* img, uint8_t* indices, Color* colors, uint8_t* alpha) {
+    uint32_t keys[PALETTIZE_HASH_SIZE];
+    int16_t slots[PALETTIZE_HASH_SIZE];
+    memset(slots, 0xFF, sizeof(slots));
+
+    int count = 0;
+    uint32_t previous_key = 0;
+    int previous_index = -1;
+    size_t pixel_count = (size_t)img->width * img->height;
+
+    for (size_t i = 0; i < pixel_count; i++) {
+        const uint8_t* px = img->data + i * img->channels;
+        uint8_t r = px[0], g = px[1], b = px[2];
+        uint8_t a = img->channels == 4 ? px[3] : 255;
+
+        uint32_t key = (uint32_t)r << 24 | (uint32_t)g << 16 | (uint32_t)b << 8 | a;
+        // Pixel art is made of runs of identical pixels
+        if (previous_index >= 0 && key == previous_key) {
+            indices[i] = (uint8_t)previous_index;
+            continue;
+        }
+
+        uint32_t slot = (key * 2654435761u) >> 22 & (PALETTIZE_HASH_SIZE - 1);
+        while (slots[slot] >= 0 && keys[slot] != key) {
+            slot = (slot + 1) & (PALETTIZE_HASH_SIZE - 1);
+        }
+        if (slots[slot] < 0) {
+            if (count == 256) {
+                return 0;
+            }
+            keys[slot] = key;
+            slots[slot] = (int16_t)count;
+            colors[count].r = r;
+            colors[count].g = g;
+            colors[count].b = b;
+            alpha[count] = a;
+            count++;
+        }
+
+        previous_key = key;
+        previous_index = slots[slot];
+        indices[i] = (uint8_t)previous_index;
+    }
+
+    return count;
+}
+
+static const int color_types[5] = {0, 0, 4, 2, 6};  // gray, gray+alpha, RGB, RGBA
+
+static int write_truecolor_png(const char* filename, const Image* img, int scale) {
+    return write_png_file(filename, img->data, img->width, img->height, 8, color_types[img->channels],
+                          img->channels, png_filter, NULL, 0, NULL, 0, scale);
+}
+
+int write_png(const char* filename, const Image* img, int scale) {
+    if (!filename || !img || !img->data || img->channels < 1 || img->channels > 4) {
+        fprintf(stderr, "Error: invalid parameters for write_png\n");
+        return 0;
+    }
+
+    // Pixel art rarely needs more than 256 colors; when it fits, an indexed
+    // PNG stores 1-8 bits per pixel instead of 24-32. Gray images already
+    // take 8-16 bits and a palette would only add PLTE and tRNS to them.
+    uint8_t* indices = img->channels >= 3 ? malloc((size_t)img->width * img->height) : NULL;
+    if (indices) {
+        Color colors[256];
+        uint8_t alpha[256];
+        int count = palettize_image(img, indices, colors, alpha);
+        if (count > 0) {
+            int result = write_indexed_png(filename, indices, img->width, img->height, colors, alpha, count, scale);
+            free(indices);
+            return result;
+        }
+        free(indices);
+    }
+
+    return write_truecolor_png(filename, img, scale);
+}
+
+// Truecolor PNG written a band of rows at a time. Filtered scanlines are
+// buffered up to PNG_STREAM_FLUSH_SIZE and then compressed into an IDAT
+// chunk, so memory stays bounded however tall the image is. The palette
+// is not known until the end, so streamed images are never indexed.
+struct PngStream {
+    FILE* file;
+    char* filename;     // removed again if the stream fails
+    int width;
+    int height;
+    int channels;
+    int rows_written;
+    int failed;
+    size_t row_bytes;
+    uint8_t* prior;     // last row written, for the next band's filters
+    uint8_t* raw;       // filtered scanlines waiting to be compressed
+    size_t raw_length;
+    size_t raw_capacity;
+    DeflateStream* deflate;
+};
+
+static int flush_png_stream(PngStream* stream, int final) {
+    size_t compressed_size = 0;
+    uint8_t* compressed = deflate_stream_write(stream->deflate, stream->raw, stream->raw_length, final,
+                                               &compressed_size);
+    stream->raw_length = 0;
+    if (!compressed) {
+        fprintf(stderr, "Error: failed to compress PNG data\n");
+        return 0;
+    }
+
+    int result = compressed_size == 0 || write_chunk(stream->file, "IDAT", compressed, compressed_size);
+    free(compressed);
+    return result;
+}
+
+PngStream* open_png_stream(const char* filename, int width, int height, int channels, int scale) {
+    if (!filename || width <= 0 || height <= 0 || channels < 1 || channels > 4) {
+        fprintf(stderr, "Error: invalid parameters for open_png_stream\n");
+        return NULL;
+    }
+
+    PngStream* stream = calloc(1, sizeof(PngStream));
+    if (!stream) {
+        fprintf(stderr, "Error: failed to allocate memory for PNG stream\n");
+        return NULL;
+    }
+    stream->width = width;
+    stream->height = height;
+    stream->channels = channels;
+    stream->row_bytes = (size_t)width * channels;
+    stream->prior = malloc(stream->row_bytes);
+    stream->deflate = create_deflate_stream(png_compression_level);
+    stream->filename = malloc(strlen(filename) + 1);
+    if (stream->filename) {
+        strcpy(stream->filename, filename);
+        stream->file = fopen(filename, "wb");
+    }
+    if (!stream->prior || !stream->deflate || !stream->file ||
+        !write_png_header(stream->file, width, height, 8, color_types[channels], scale)) {
+        fprintf(stderr, "Error: failed to start PNG file %s\n", filename);
+        stream->failed = 1;
+        close_png_stream(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+// Appends count rows of width * channels bytes each
+int write_png_stream_rows(PngStream* stream, const uint8_t* rows, int count) {
+    if (stream->failed || count <= 0 || count > stream->height - stream->rows_written) {
+        stream->failed = 1;
+        return 0;
+    }
+
+    size_t band_size = (stream->row_bytes + 1) * count;
+    if (stream->raw_length + band_size > stream->raw_capacity) {
+        size_t capacity = stream->raw_length + band_size;
+        if (capacity < PNG_STREAM_FLUSH_SIZE + band_size) {
+            capacity = PNG_STREAM_FLUSH_SIZE + band_size;
+        }
+        uint8_t* raw = realloc(stream->raw, capacity);
+        if (!raw) {
+            fprintf(stderr, "Error: failed to allocate memory for PNG scanlines\n");
+            stream->failed = 1;
+            return 0;
+        }
+        stream->raw = raw;
+        stream->raw_capacity = capacity;
+    }
+
+    const uint8_t* prior = stream->rows_written > 0 ? stream->prior : NULL;
+    if (!filter_band(rows, prior, count, stream->row_bytes, stream->channels, png_filter,
+                     stream->raw + stream->raw_length)) {
+        stream->failed = 1;
+        return 0;
+    }
+    stream->raw_length += band_size;
+    stream->rows_written += count;
+    memcpy(stream->prior, rows + (count - 1) * stream->row_bytes, stream->row_bytes);
+
+    if (stream->raw_length >= PNG_STREAM_FLUSH_SIZE && !flush_png_stream(stream, 0)) {
+        stream->failed = 1;
+        return 0;
+    }
+    return 1;
+}
+
+// Finishes the file and frees the stream. A stream that is missing rows or
+// failed to write leaves no partial file behind.
+int close_png_stream(PngStream* stream) {
+    if (!stream) {
+        return 0;
+    }
+
+    int result = !stream->failed;
+    if (result && stream->rows_written != stream->height) {
+        fprintf(stderr, "Error: PNG stream closed after %d of %d rows\n", stream->rows_written, stream->height);
+        result = 0;
+    }
+    if (result) {
+        result = flush_png_stream(stream, 1) && write_chunk(stream->file, "IEND", NULL, 0);
+    }
+    if (stream->file) {
+        result = fclose(stream->file) == 0 && result;
+        if (!result) {
+            remove(stream->filename);
+        }
+    }
+
+    free(stream->filename);
+    free_deflate_stream(stream->deflate);
+    free(stream->prior);
+    free(stream->raw);
+    free(stream);
+    return result;
+}
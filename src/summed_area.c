@@ -0,0 +1,229 @@
+#include "../include/pixel_art.h"
+
+// Summed-area table for block averages. After one build, the sum over any
+// rectangle is four lookups, so averaging cells of every block size costs
+// O(cells) rather than a pass over the input per size.
+//
+// The table is built in a single parallel pass: each band of rows
+// accumulates its own running sums starting from zero, and the row above
+// each band (its carry) is filled in afterwards with one row of additions
+// per band. Lookups add the carry back instead of rewriting the table.
+
+#define SAT_MIN_BAND_ROWS 64
+
+typedef struct {
+    const Image* src;
+    SummedAreaTable* table;
+} TableBuildContext;
+
+// Running per-channel sums of one image row, written after the zero entry.
+// Inlined with a constant channel count so the channel loop unrolls.
+static inline void prefix_row(const uint8_t* in, uint32_t* row, int width, int channels) {
+    uint32_t running[4] = {0, 0, 0, 0};
+    for (int x = 0; x < width; x++) {
+        for (int c = 0; c < channels; c++) {
+            running[c] += in[x * channels + c];
+            row[(size_t)(x + 1) * channels + c] = running[c];
+        }
+    }
+}
+
+static void sum_table_bands(void* context, int start, int end, int worker) {
+    const TableBuildContext* ctx = context;
+    const Image* src = ctx->src;
+    SummedAreaTable* table = ctx->table;
+    int channels = table->channels;
+    size_t row_entries = (size_t)(table->width + 1) * channels;
+    (void)worker;
+
+    for (int band = start; band < end; band++) {
+        int first = band * table->band_rows;
+        int last = first + table->band_rows < table->height + 1 ? first + table->band_rows : table->height + 1;
+
+        for (int y = first; y < last; y++) {
+            uint32_t* row = table->sums + y * row_entries;
+            if (y == 0) {
+                memset(row, 0, row_entries * sizeof(uint32_t));
+                continue;
+            }
+
+            // Running sum along the image row...
+            const uint8_t* in = src->data + (size_t)(y - 1) * src->width * channels;
+            memset(row, 0, channels * sizeof(uint32_t));
+            switch (channels) {
+                case 1: prefix_row(in, row, table->width, 1); break;
+                case 2: prefix_row(in, row, table->width, 2); break;
+                case 3: prefix_row(in, row, table->width, 3); break;
+                default: prefix_row(in, row, table->width, 4); break;
+            }
+
+            // ...plus the band-local row above
+            if (y > first) {
+                const uint32_t* above = row - row_entries;
+                for (size_t i = 0; i < row_entries; i++) {
+                    row[i] += above[i];
+                }
+            }
+        }
+    }
+}
+
+SummedAreaTable* create_summed_area_table(const Image* src) {
+    if (!src || !src->data || src->channels < 1 || src->channels > 4) {
+        fprintf(stderr, "Error: invalid parameters for create_summed_area_table\n");
+        return NULL;
+    }
+
+    SummedAreaTable* table = calloc(1, sizeof(SummedAreaTable));
+    if (!table) {
+        fprintf(stderr, "Error: failed to allocate memory for summed-area table\n");
+        return NULL;
+    }
+
+    int rows = src->height + 1;
+    int workers = parallel_worker_count(rows);
+    int band_rows = (rows + workers - 1) / workers;
+    if (band_rows < SAT_MIN_BAND_ROWS) band_rows = SAT_MIN_BAND_ROWS;
+    int band_count = (rows + band_rows - 1) / band_rows;
+    size_t row_entries = (size_t)(src->width + 1) * src->channels;
+
+    table->width = src->width;
+    table->height = src->height;
+    table->channels = src->channels;
+    table->band_rows = band_rows;
+    table->sums = malloc(row_entries * rows * sizeof(uint32_t));
+    table->carries = malloc(row_entries * band_count * sizeof(uint32_t));
+    if (!table->sums || !table->carries) {
+        fprintf(stderr, "Error: failed to allocate memory for summed-area table\n");
+        free_summed_area_table(table);
+        return NULL;
+    }
+
+    printf("Building %dx%d summed-area table\n", src->width, src->height);
+    TableBuildContext ctx = {src, table};
+    parallel_for(band_count, 0, sum_table_bands, &ctx);
+
+    // Each band's carry is the true sum on the last row of the band before it
+    memset(table->carries, 0, row_entries * sizeof(uint32_t));
+    for (int band = 1; band < band_count; band++) {
+        const uint32_t* previous = table->carries + (band - 1) * row_entries;
+        const uint32_t* last_row = table->sums + ((size_t)band * band_rows - 1) * row_entries;
+        uint32_t* carry = table->carries + band * row_entries;
+        for (size_t i = 0; i < row_entries; i++) {
+            carry[i] = previous[i] + last_row[i];
+        }
+    }
+
+    return table;
+}
+
+void free_summed_area_table(SummedAreaTable* table) {
+    if (!table) {
+        return;
+    }
+    free(table->sums);
+    free(table->carries);
+    free(table);
+}
+
+// Table row y with its band's carry applied, as two pointers to add
+static inline void table_row(const SummedAreaTable* table, int y, const uint32_t** sums, const uint32_t** carry) {
+    size_t row_entries = (size_t)(table->width + 1) * table->channels;
+    *sums = table->sums + y * row_entries;
+    *carry = table->carries + (y / table->band_rows) * row_entries;
+}
+
+// Sum of rows [y0, y1) and columns [x0, x1) for every channel. Differences
+// are taken modulo 2^32, which is exact while the block sum fits.
+static void block_sum(const SummedAreaTable* table, int x0, int y0, int x1, int y1, uint32_t* out) {
+    const uint32_t *top, *top_carry, *bottom, *bottom_carry;
+    table_row(table, y0, &top, &top_carry);
+    table_row(table, y1, &bottom, &bottom_carry);
+
+    int channels = table->channels;
+    size_t left = (size_t)x0 * channels;
+    size_t right = (size_t)x1 * channels;
+    for (int c = 0; c < channels; c++) {
+        uint32_t br = bottom[right + c] + bottom_carry[right + c];
+        uint32_t bl = bottom[left + c] + bottom_carry[left + c];
+        uint32_t tr = top[right + c] + top_carry[right + c];
+        uint32_t tl = top[left + c] + top_carry[left + c];
+        out[c] = br - bl - tr + tl;
+    }
+}
+
+// Rounded mean of each channel over columns [x0, x1) and rows [y0, y1)
+void summed_area_mean(const SummedAreaTable* table, int x0, int y0, int x1, int y1, uint8_t* out) {
+    uint64_t area = (uint64_t)(x1 - x0) * (y1 - y0);
+    uint64_t totals[4] = {0, 0, 0, 0};
+    uint32_t sums[4];
+
+    if (area <= SAT_MAX_AREA) {
+        block_sum(table, x0, y0, x1, y1, sums);
+        for (int c = 0; c < table->channels; c++) totals[c] = sums[c];
+    } else {
+        // Larger blocks could wrap; add them up in strips that cannot
+        int strip_rows = SAT_MAX_AREA / (x1 - x0);
+        if (strip_rows < 1) strip_rows = 1;
+        for (int y = y0; y < y1; y += strip_rows) {
+            int strip_end = y + strip_rows < y1 ? y + strip_rows : y1;
+            block_sum(table, x0, y, x1, strip_end, sums);
+            for (int c = 0; c < table->channels; c++) totals[c] += sums[c];
+        }
+    }
+
+    for (int c = 0; c < table->channels; c++) {
+        out[c] = (uint8_t)((totals[c] + area / 2) / area);
+    }
+}
+
+typedef struct {
+    const SummedAreaTable* table;
+    const int* x_edges;
+    const int* y_edges;
+    Image* dst;
+} CellMeanContext;
+
+static void average_cell_rows(void* context, int start, int end, int worker) {
+    const CellMeanContext* ctx = context;
+    Image* dst = ctx->dst;
+    (void)worker;
+
+    for (int cell_y = start; cell_y < end; cell_y++) {
+        uint8_t* out = dst->data + (size_t)cell_y * dst->width * dst->channels;
+        for (int cell_x = 0; cell_x < dst->width; cell_x++) {
+            summed_area_mean(ctx->table, ctx->x_edges[cell_x], ctx->y_edges[cell_y],
+                             ctx->x_edges[cell_x + 1], ctx->y_edges[cell_y + 1], out + cell_x * dst->channels);
+        }
+    }
+}
+
+// Averages a grid of cells. Cell (x, y) covers columns x_edges[x] up to
+// x_edges[x + 1] and rows y_edges[y] up to y_edges[y + 1]; both edge lists
+// have one more entry than the grid has cells.
+Image* summed_area_cells(const SummedAreaTable* table, const int* x_edges, int grid_width,
+                         const int* y_edges, int grid_height) {
+    if (!table || !x_edges || !y_edges || grid_width <= 0 || grid_height <= 0) {
+        fprintf(stderr, "Error: invalid parameters for summed_area_cells\n");
+        return NULL;
+    }
+
+    Image* dst = malloc(sizeof(Image));
+    if (!dst) {
+        fprintf(stderr, "Error: failed to allocate memory for averaged cells\n");
+        return NULL;
+    }
+    dst->width = grid_width;
+    dst->height = grid_height;
+    dst->channels = table->channels;
+    dst->data = malloc((size_t)grid_width * grid_height * table->channels);
+    if (!dst->data) {
+        fprintf(stderr, "Error: failed to allocate memory for averaged cells\n");
+        free(dst);
+        return NULL;
+    }
+
+    CellMeanContext ctx = {table, x_edges, y_edges, dst};
+    parallel_for(grid_height, 0, average_cell_rows, &ctx);
+    return dst;
+}
@@ -0,0 +1,215 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../include/pixel_art.h"
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+static int thread_count = 0;
+
+// Persistent workers behind parallel_for. A call posts a job split into
+// ranges; idle pool threads and the calling thread claim ranges until none
+// are left, and the caller waits until every range has finished. Several
+// threads may call parallel_for at once: jobs queue up, and pool threads
+// serve the oldest job that still has ranges to hand out.
+typedef struct ParallelJob {
+    ParallelTask task;
+    void* context;
+    int count;
+    int ranges;
+    int next_range;
+    int finished;
+    struct ParallelJob* next;
+} ParallelJob;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;  // a job was posted or the pool is stopping
+    pthread_cond_t done;  // the last range of some job finished
+    ParallelJob* head;
+    ParallelJob* tail;
+    pthread_t* threads;
+    int size;
+    int stopping;
+} ThreadPool;
+
+static ThreadPool pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                          NULL, NULL, NULL, 0, 0};
+static int pool_started = 0;
+static pthread_once_t default_pool_once = PTHREAD_ONCE_INIT;
+
+// Per-thread cap on parallel_for workers, for callers such as batch stage
+// workers that share the thread count with each other
+static pthread_key_t budget_key;
+static pthread_once_t budget_key_once = PTHREAD_ONCE_INIT;
+
+int get_thread_count(void) {
+    if (thread_count <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = online > 0 ? (int)online : 1;
+    }
+    return thread_count;
+}
+
+// Claims the next range of the oldest job with ranges left; call with the
+// lock held. A job leaves the queue once its last range is claimed.
+static ParallelJob* claim_range(ParallelJob* only, int* range) {
+    ParallelJob* job = only ? only : pool.head;
+    if (!job || job->next_range >= job->ranges) {
+        return NULL;
+    }
+
+    *range = job->next_range++;
+    if (job->next_range == job->ranges) {
+        ParallelJob** link = &pool.head;
+        while (*link != job) link = &(*link)->next;
+        *link = job->next;
+        if (pool.tail == job) {
+            pool.tail = NULL;
+            for (ParallelJob* j = pool.head; j; j = j->next) pool.tail = j;
+        }
+    }
+    return job;
+}
+
+// Runs one claimed range with the lock released and reports it finished.
+// The job lives on its caller's stack, so it is not touched afterwards.
+static void run_range(ParallelJob* job, int range) {
+    pthread_mutex_unlock(&pool.lock);
+    int start = (int)((long long)job->count * range / job->ranges);
+    int end = (int)((long long)job->count * (range + 1) / job->ranges);
+    job->task(job->context, start, end, range);
+    pthread_mutex_lock(&pool.lock);
+
+    if (++job->finished == job->ranges) {
+        pthread_cond_broadcast(&pool.done);
+    }
+}
+
+static void* run_pool_thread(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&pool.lock);
+    while (!pool.stopping) {
+        int range;
+        ParallelJob* job = claim_range(NULL, &range);
+        if (job) {
+            run_range(job, range);
+        } else {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+static void stop_pool(void) {
+    pthread_mutex_lock(&pool.lock);
+    pool.stopping = 1;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (int i = 0; i < pool.size; i++) {
+        pthread_join(pool.threads[i], NULL);
+    }
+    free(pool.threads);
+    pool.threads = NULL;
+    pool.size = 0;
+    pool.stopping = 0;
+}
+
+// The caller of parallel_for is always one of the workers, so the pool
+// holds one thread fewer than the thread count. Threads that fail to start
+// are simply missing; callers then run more of their own ranges.
+static void start_pool(int workers) {
+    if (pool_started) {
+        stop_pool();
+    } else {
+        atexit(stop_pool);
+    }
+    pool_started = 1;
+
+    pool.threads = workers > 1 ? malloc((workers - 1) * sizeof(pthread_t)) : NULL;
+    for (int i = 0; pool.threads && i < workers - 1; i++) {
+        if (pthread_create(&pool.threads[pool.size], NULL, run_pool_thread, NULL) == 0) {
+            pool.size++;
+        }
+    }
+}
+
+// Without set_thread_count the pool is sized on first use
+static void start_default_pool(void) {
+    if (!pool_started) {
+        start_pool(get_thread_count());
+    }
+}
+
+// Resizes the worker pool; must not be called while parallel_for runs
+void set_thread_count(int count) {
+    thread_count = count > 0 ? count : 0;
+    start_pool(get_thread_count());
+}
+
+// Monotonic wall clock for stage timings and benchmarks
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void create_budget_key(void) {
+    pthread_key_create(&budget_key, NULL);
+}
+
+// Limits parallel_for calls made from this thread to at most workers
+// workers; 0 removes the limit. Unlike set_thread_count this leaves the
+// pool and other threads alone.
+void set_worker_budget(int workers) {
+    pthread_once(&budget_key_once, create_budget_key);
+    pthread_setspecific(budget_key, (void*)(intptr_t)(workers > 0 ? workers : 0));
+}
+
+int parallel_worker_count(int count) {
+    pthread_once(&budget_key_once, create_budget_key);
+    int budget = (int)(intptr_t)pthread_getspecific(budget_key);
+    int workers = get_thread_count();
+    if (budget > 0 && workers > budget) workers = budget;
+    if (workers > count) workers = count;
+    return workers > 0 ? workers : 1;
+}
+
+// Splits [0, count) into one range per worker and runs task on each, with
+// worker set to the range's index. Returns the number of ranges.
+int parallel_for(int count, int workers, ParallelTask task, void* context) {
+    if (count <= 0) {
+        return 0;
+    }
+    if (workers <= 0 || workers > count) {
+        workers = parallel_worker_count(count);
+    }
+
+    if (workers == 1) {
+        task(context, 0, count, 0);
+        return 1;
+    }
+
+    pthread_once(&default_pool_once, start_default_pool);
+    ParallelJob job = {task, context, count, workers, 0, 0, NULL};
+    pthread_mutex_lock(&pool.lock);
+    if (pool.tail) {
+        pool.tail->next = &job;
+    } else {
+        pool.head = &job;
+    }
+    pool.tail = &job;
+    pthread_cond_broadcast(&pool.wake);
+
+    // Help with this job only, then wait for the ranges pool threads took
+    int range;
+    while (claim_range(&job, &range)) {
+        run_range(&job, range);
+    }
+    while (job.finished < job.ranges) {
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return workers;
+}
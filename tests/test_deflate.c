@@ -0,0 +1,170 @@
+// Deflate round-trip test: buffers compressed by zlib_compress and by a
+// DeflateStream fed in pieces must inflate back to the same bytes with
+// inflate.c at every compression level, end with the right Adler-32, and
+// not depend on the thread count.
+//
+// Usage: test_deflate
+
+#include "../include/pixel_art.h"
+
+#define CHUNK (256 * 1024)  // DEFLATE_CHUNK_SIZE in deflate.c
+
+typedef enum {
+    DATA_RANDOM,      // incompressible
+    DATA_REPETITIVE,  // a short period, almost all matches
+    DATA_MIXED        // runs and a small alphabet, like filtered pixel rows
+} DataKind;
+
+static const char* kind_names[] = {"random", "repetitive", "mixed"};
+
+static const size_t sizes[] = {0, 1, CHUNK - 1, CHUNK, CHUNK + 1, 3 * CHUNK + 12345};
+
+static int failures = 0;
+
+static void check(int ok, const char* what, DataKind kind, size_t size, int level) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s (%s, %zu bytes, level %d)\n", what, kind_names[kind], size, level);
+        failures++;
+    }
+}
+
+static uint8_t* create_data(DataKind kind, size_t size) {
+    uint8_t* data = malloc(size > 0 ? size : 1);
+    uint32_t state = 777;
+    for (size_t i = 0; i < size; i++) {
+        state = state * 1664525u + 1013904223u;
+        if (kind == DATA_RANDOM) {
+            data[i] = (uint8_t)(state >> 24);
+        } else if (kind == DATA_REPETITIVE) {
+            data[i] = (uint8_t)("pixel art "[i % 10]);
+        } else {
+            data[i] = (state >> 28) < 3 ? (uint8_t)(state >> 24 & 7) : (i > 0 ? data[i - 1] : 0);
+        }
+    }
+    return data;
+}
+
+// Straightforward Adler-32, independent of adler32_update
+static uint32_t reference_adler32(const uint8_t* data, size_t length) {
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < length; i++) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return b << 16 | a;
+}
+
+typedef struct {
+    const uint8_t* data;
+    size_t length;
+    size_t pos;
+} MemorySource;
+
+static size_t read_memory(void* context, uint8_t* buffer, size_t capacity) {
+    MemorySource* source = context;
+    size_t count = source->length - source->pos < capacity ? source->length - source->pos : capacity;
+    memcpy(buffer, source->data + source->pos, count);
+    source->pos += count;
+    return count;
+}
+
+// Inflates the stream and checks it reproduces data exactly, with nothing
+// after it, and that the trailer holds the data's Adler-32
+static void check_stream(const uint8_t* stream, size_t stream_length, const uint8_t* data, size_t size,
+                         DataKind kind, int level) {
+    if (!stream || stream_length < 6) {
+        check(0, "compressed stream", kind, size, level);
+        return;
+    }
+
+    // Everything before the 4-byte trailer is inflated
+    MemorySource source = {stream, stream_length - 4, 0};
+    Inflater* inflater = create_inflater(read_memory, &source);
+    uint8_t* out = malloc(size + 1);
+    size_t produced = inflater && out ? inflate_read(inflater, out, size + 1) : 0;
+    check(inflater && !inflater_failed(inflater), "inflate without errors", kind, size, level);
+    check(produced == size && memcmp(out, data, size) == 0, "inflated bytes match", kind, size, level);
+
+    const uint8_t* trailer = stream + stream_length - 4;
+    uint32_t adler = (uint32_t)trailer[0] << 24 | (uint32_t)trailer[1] << 16 | (uint32_t)trailer[2] << 8 | trailer[3];
+    check(adler == reference_adler32(data, size), "Adler-32 trailer", kind, size, level);
+
+    free(out);
+    if (inflater) free_inflater(inflater);
+}
+
+// Feeds data through a DeflateStream in uneven pieces, the way streamed
+// PNG output arrives in bands
+static uint8_t* compress_in_pieces(const uint8_t* data, size_t size, int level, size_t* out_length) {
+    DeflateStream* stream = create_deflate_stream(level);
+    uint8_t* result = NULL;
+    size_t length = 0;
+    size_t pos = 0;
+    size_t piece = 1;
+    int final = 0;
+
+    while (stream && !final) {
+        size_t count = size - pos < piece ? size - pos : piece;
+        final = pos + count == size;
+        size_t part_length = 0;
+        uint8_t* part = deflate_stream_write(stream, data + pos, count, final, &part_length);
+        if (!part) {
+            free(result);
+            result = NULL;
+            break;
+        }
+        uint8_t* grown = realloc(result, length + part_length + 1);
+        memcpy(grown + length, part, part_length);
+        result = grown;
+        length += part_length;
+        free(part);
+
+        pos += count;
+        piece = piece * 7 + 40000;
+    }
+
+    free_deflate_stream(stream);
+    *out_length = length;
+    return result;
+}
+
+int main(void) {
+    int thread_count = get_thread_count();
+
+    for (int kind = DATA_RANDOM; kind <= DATA_MIXED; kind++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            size_t size = sizes[s];
+            uint8_t* data = create_data(kind, size);
+
+            for (int level = 0; level <= 9; level++) {
+                size_t length = 0;
+                set_thread_count(4);
+                uint8_t* parallel = zlib_compress(data, size, level, &length);
+                check_stream(parallel, length, data, size, kind, level);
+
+                // Chunk boundaries depend only on the input, so one thread
+                // must write the same bytes
+                size_t serial_length = 0;
+                set_thread_count(1);
+                uint8_t* serial = zlib_compress(data, size, level, &serial_length);
+                check(parallel && serial && serial_length == length && memcmp(serial, parallel, length) == 0,
+                      "output independent of thread count", kind, size, level);
+                free(parallel);
+                free(serial);
+
+                uint8_t* pieces = compress_in_pieces(data, size, level, &length);
+                check_stream(pieces, length, data, size, kind, level);
+                free(pieces);
+            }
+            free(data);
+        }
+    }
+    set_thread_count(thread_count);
+
+    if (failures) {
+        fprintf(stderr, "%d deflate checks failed\n", failures);
+        return 1;
+    }
+    printf("Deflate tests passed\n");
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Grid size test: every mode must split an image whose size is not a
+// multiple of the block size into the same ceil(size / pixel_size) blocks,
+// with a ragged last block of its own.
+//
+// Usage: test_grid_size
+
+#include "../include/pixel_art.h"
+
+#define TEST_WIDTH 100
+#define TEST_HEIGHT 37
+#define TEST_PIXEL_SIZE 8
+#define TEST_GRID_WIDTH 13  // ceil(100 / 8)
+#define TEST_GRID_HEIGHT 5  // ceil(37 / 8)
+
+static int failures = 0;
+
+static void check(int ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static Image* create_pattern_image(void) {
+    Image* img = malloc(sizeof(Image));
+    img->width = TEST_WIDTH;
+    img->height = TEST_HEIGHT;
+    img->channels = 3;
+    img->data = malloc((size_t)TEST_WIDTH * TEST_HEIGHT * 3);
+
+    uint32_t state = 2024;
+    for (size_t i = 0; i < (size_t)TEST_WIDTH * TEST_HEIGHT * 3; i++) {
+        state = state * 1664525u + 1013904223u;
+        img->data[i] = (uint8_t)(state >> 24);
+    }
+    return img;
+}
+
+static void check_size(const Image* src, ConvertMode mode, int compact, const char* what) {
+    ConvertOptions options;
+    init_convert_options(&options);
+    options.mode = mode;
+    options.pixel_size = TEST_PIXEL_SIZE;
+    options.max_colors = 8;
+    options.compact = compact;
+
+    Image* out = convert_image(src, &options);
+    int width = compact ? TEST_GRID_WIDTH : TEST_WIDTH;
+    int height = compact ? TEST_GRID_HEIGHT : TEST_HEIGHT;
+    check(out && out->width == width && out->height == height, what);
+    free_image(out);
+}
+
+// The ragged corner cell must average only the pixels of its own block
+static void check_corner_cell(const Image* src, const Image* low_res, const char* what) {
+    int x0 = (TEST_GRID_WIDTH - 1) * TEST_PIXEL_SIZE;
+    int y0 = (TEST_GRID_HEIGHT - 1) * TEST_PIXEL_SIZE;
+    int area = (TEST_WIDTH - x0) * (TEST_HEIGHT - y0);
+    const uint8_t* cell = low_res->data + ((size_t)low_res->width * low_res->height - 1) * low_res->channels;
+
+    for (int c = 0; c < 3; c++) {
+        int sum = 0;
+        for (int y = y0; y < TEST_HEIGHT; y++) {
+            for (int x = x0; x < TEST_WIDTH; x++) {
+                sum += src->data[((size_t)y * TEST_WIDTH + x) * 3 + c];
+            }
+        }
+        check(cell[c] == (sum + area / 2) / area, what);
+    }
+}
+
+int main(void) {
+    Image* src = create_pattern_image();
+
+    check_size(src, CONVERT_PRESERVE, 1, "preserve compact size");
+    check_size(src, CONVERT_PALETTE, 1, "palette compact size");
+    check_size(src, CONVERT_ADAPTIVE, 1, "adaptive compact size");
+    check_size(src, CONVERT_PRESERVE, 0, "preserve full size");
+    check_size(src, CONVERT_PALETTE, 0, "palette full size");
+    check_size(src, CONVERT_ADAPTIVE, 0, "adaptive full size");
+
+    // The box filter and the summed-area table must build the same cells
+    Image* low_res = create_low_res_image(src, TEST_PIXEL_SIZE);
+    SummedAreaTable* table = create_summed_area_table(src);
+    Image* from_table = table ? create_low_res_from_table(table, TEST_PIXEL_SIZE) : NULL;
+    check(low_res && low_res->width == TEST_GRID_WIDTH && low_res->height == TEST_GRID_HEIGHT,
+          "low resolution grid size");
+    check(low_res && from_table && from_table->width == low_res->width && from_table->height == low_res->height &&
+          memcmp(low_res->data, from_table->data,
+                 (size_t)low_res->width * low_res->height * low_res->channels) == 0,
+          "box filter and summed-area cells match");
+    if (low_res) {
+        check_corner_cell(src, low_res, "ragged corner cell mean");
+    }
+
+    free_image(from_table);
+    free_summed_area_table(table);
+    free_image(low_res);
+    free_image(src);
+
+    if (failures) {
+        fprintf(stderr, "%d grid size checks failed\n", failures);
+        return 1;
+    }
+    printf("Grid size tests passed\n");
+    return 0;
+}
@@ -0,0 +1,95 @@
+// Indexed PNG test: IndexedImages saved with save_indexed_image must read
+// back as the same pixels, with and without an alpha plane, and when the
+// color/alpha pairs overflow a PNG palette and the image is expanded.
+//
+// Usage: test_indexed_png
+
+#include "../include/pixel_art.h"
+
+#define TEST_WIDTH 37
+#define TEST_HEIGHT 11
+#define TEST_SCALE 4
+
+static int failures = 0;
+
+static void check(int ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static Palette* create_test_palette(void) {
+    Palette* palette = create_palette(5);
+    add_color_to_palette(palette, 0, 0, 0);
+    add_color_to_palette(palette, 255, 255, 255);
+    add_color_to_palette(palette, 200, 30, 40);
+    add_color_to_palette(palette, 10, 180, 90);
+    add_color_to_palette(palette, 20, 40, 250);
+    return palette;
+}
+
+// alpha_levels distinct alpha values are cycled through, so the number of
+// color/alpha pairs grows with it
+static IndexedImage* create_test_image(const Palette* palette, int alpha_levels) {
+    IndexedImage* img = create_indexed_image(TEST_WIDTH, TEST_HEIGHT, palette, alpha_levels > 0);
+    for (int i = 0; i < TEST_WIDTH * TEST_HEIGHT; i++) {
+        img->indices[i] = (uint8_t)((i * 7 + i / TEST_WIDTH) % palette->count);
+        if (img->alpha) {
+            img->alpha[i] = (uint8_t)(255 - (i * 13 % alpha_levels) * (255 / alpha_levels));
+        }
+    }
+    return img;
+}
+
+static void check_round_trip(const IndexedImage* img, const char* path, const char* what) {
+    if (!save_indexed_image(path, img, TEST_SCALE)) {
+        check(0, what);
+        return;
+    }
+
+    Image* loaded = load_image(path);
+    remove(path);
+    int channels = img->alpha ? 4 : 3;
+    int ok = loaded && loaded->width == img->width && loaded->height == img->height &&
+             loaded->channels == channels;
+    for (int i = 0; ok && i < img->width * img->height; i++) {
+        const Color* color = &img->palette->colors[img->indices[i]];
+        const uint8_t* px = loaded->data + (size_t)i * channels;
+        ok = px[0] == color->r && px[1] == color->g && px[2] == color->b &&
+             (!img->alpha || px[3] == img->alpha[i]);
+    }
+    check(ok, what);
+    free_image(loaded);
+}
+
+int main(void) {
+    const char* dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/test_indexed_png.png", dir);
+
+    Palette* palette = create_test_palette();
+
+    IndexedImage* opaque = create_test_image(palette, 0);
+    check_round_trip(opaque, path, "opaque indexed image");
+
+    // A few alpha levels fit PLTE + tRNS; more than 256 color/alpha pairs
+    // fall back to an RGBA image
+    IndexedImage* translucent = create_test_image(palette, 4);
+    check_round_trip(translucent, path, "indexed image with alpha plane");
+
+    IndexedImage* many_pairs = create_test_image(palette, 85);
+    check_round_trip(many_pairs, path, "indexed image with more than 256 color/alpha pairs");
+
+    free_indexed_image(opaque);
+    free_indexed_image(translucent);
+    free_indexed_image(many_pairs);
+    free_palette(palette);
+
+    if (failures) {
+        fprintf(stderr, "%d indexed PNG checks failed\n", failures);
+        return 1;
+    }
+    printf("Indexed PNG tests passed\n");
+    return 0;
+}